@@ -1,110 +1,1343 @@
-#include "file.h"
-#include <fstream>
-#include <sstream>
-#include <vector>
-#include <iomanip>
-
-
-void File::read_verts(const std::string &filename, Verts &verts)
-{
-    std::ifstream fin(filename.c_str());
-
-    if (fin.fail())
-        return;
-
-    std::string x, y, z;
-    std::stringstream ss;
-    Vert vert;
-
-    while (!std::getline(fin, x, ',').eof())
-    {
-        std::getline(fin, y, ',');
-        std::getline(fin, z);
-        ss << x, ss >> vert.x, ss.str(""), ss.clear();
-        ss << y, ss >> vert.y, ss.str(""), ss.clear();
-        ss << z, ss >> vert.z, ss.str(""), ss.clear();
-        verts.insert(vert);
-    }
-
-    fin.close();
-}
-
-void File::read_faces(const std::string &filename, Faces &faces)
-{
-    std::ifstream fin(filename.c_str());
-
-    if (fin.fail())
-        return;
-
-    std::string v1, v2, v3;
-    std::stringstream ss;
-    Face face;
-
-    while (!std::getline(fin, v1, ',').eof())
-    {
-        std::getline(fin, v2, ',');
-        std::getline(fin, v3);
-        ss << v1, ss >> face.v1, ss.str(""), ss.clear();
-        ss << v2, ss >> face.v2, ss.str(""), ss.clear();
-        ss << v3, ss >> face.v3, ss.str(""), ss.clear();
-        faces.insert(face, nullptr);
-    }
-
-    fin.close();
-}
-
-
-void File::write_verts(const Verts &verts, const std::string &filename)
-{
-    std::ofstream fout(filename.c_str());
-
-    if (fout.fail())
-        return;
-
-    std::vector<Vert> vector;
-    vector.resize(verts.size());
-    verts.copy_all(&vector[0]);
-
-    for (std::size_t i = 0; i != vector.size(); i++)
-        fout << std::setprecision(15) << vector[i].x << ","
-             << vector[i].y << "," << vector[i].z << "\n";
-
-    fout.close();
-}
-
-void File::write_edges(const Edges &edges, const std::string &filename)
-{
-    std::ofstream fout(filename.c_str());
-
-    if (fout.fail())
-        return;
-
-    std::vector<Edge> vector;
-    vector.resize(edges.size());
-    edges.copy_all(&vector[0]);
-
-    for (std::size_t i = 0; i != vector.size(); i++)
-        fout << vector[i].v1 << "," << vector[i].v2 << "\n";
-
-    fout.close();
-}
-
-void File::write_faces(const Faces &faces, const std::string &filename)
-{
-    std::ofstream fout(filename.c_str());
-
-    if (fout.fail())
-        return;
-
-    std::vector<Face> vectorFaces;
-    std::vector<void *> vectorPtr;
-    vectorFaces.resize(faces.size());
-    vectorPtr.resize(faces.size());
-    faces.copy_all(&vectorFaces[0], &vectorPtr[0]);
-
-    for (std::size_t i = 0; i != vectorFaces.size(); i++)
-        fout << vectorFaces[i].v1 << "," << vectorFaces[i].v2 << ","
-             << vectorFaces[i].v3 << "\n";
-
-    fout.close();
-}
\ No newline at end of file
+#include "file.h"
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <iomanip>
+#include <algorithm>
+#include <queue>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __WIN32__
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+// Sorts more records than fit in memory. Records are buffered up to the
+// budget, sorted and spilled as runs to one temporary file, and the runs
+// are merged back while draining, FAN at a time into a second file until
+// few enough are left. A spill never has more than 2 files open, and the
+// merges read their runs in blocks of the buffer.
+template <typename Record>
+class Spill
+{
+    static const std::size_t FAN = 16;
+
+    struct Run
+    {
+        std::fpos_t position;
+        std::size_t size;
+    };
+
+    std::size_t capacity;
+    std::vector<Record> buffer;
+    std::FILE *file;
+    std::vector<Run> runs;
+    bool failed;
+    bool (*less)(const Record &, const Record &);
+
+    void flush()
+    {
+        std::sort(this->buffer.begin(), this->buffer.end(), this->less);
+        Run run;
+        run.size = this->buffer.size();
+
+        if (this->file == nullptr)
+            this->file = std::tmpfile();
+
+        if (this->file == nullptr ||
+            std::fgetpos(this->file, &run.position) != 0 ||
+            std::fwrite(this->buffer.data(), sizeof(Record), run.size,
+                        this->file) != run.size)
+            this->failed = true;
+        else
+            this->runs.push_back(run);
+
+        this->buffer.clear();
+    }
+
+    // Visits the runs in [first, last) in order.
+    template <typename Visit>
+    void merge(std::size_t first, std::size_t last, Visit visit)
+    {
+        auto count = last - first;
+        auto block = std::max<std::size_t>(this->capacity / count, 1);
+        this->buffer.resize(block * count);
+        std::vector<std::size_t> cursors(count, 0), sizes(count, 0);
+        auto greater = [&](const std::pair<Record, std::size_t> &a,
+                           const std::pair<Record, std::size_t> &b) {
+            return this->less(b.first, a.first);
+        };
+        std::priority_queue<std::pair<Record, std::size_t>,
+                            std::vector<std::pair<Record, std::size_t>>,
+                            decltype(greater)>
+            heap(greater);
+
+        auto next = [&](std::size_t idx, Record &record) {
+            auto &run = this->runs[first + idx];
+
+            if (cursors[idx] == sizes[idx])
+            {
+                if (run.size == 0 || this->failed)
+                    return false;
+
+                auto size = std::min(block, run.size);
+
+                if (std::fsetpos(this->file, &run.position) != 0 ||
+                    std::fread(&this->buffer[idx * block], sizeof(Record),
+                               size, this->file) != size ||
+                    std::fgetpos(this->file, &run.position) != 0)
+                {
+                    this->failed = true;
+                    return false;
+                }
+
+                run.size -= size;
+                sizes[idx] = size;
+                cursors[idx] = 0;
+            }
+
+            record = this->buffer[idx * block + cursors[idx]++];
+            return true;
+        };
+
+        for (std::size_t idx = 0; idx != count; idx++)
+        {
+            Record record;
+
+            if (next(idx, record))
+                heap.push(std::pair<Record, std::size_t>(record, idx));
+        }
+
+        while (!heap.empty())
+        {
+            auto top = heap.top();
+            heap.pop();
+            visit(top.first);
+
+            if (next(top.second, top.first))
+                heap.push(top);
+        }
+
+        this->buffer.clear();
+    }
+
+    // Merges every FAN runs into one run of a new file.
+    void pass()
+    {
+        auto file = std::tmpfile();
+        std::vector<Run> runs;
+
+        for (std::size_t first = 0;
+             first < this->runs.size() && file != nullptr && !this->failed;
+             first += FAN)
+        {
+            auto last = std::min(first + FAN, this->runs.size());
+            Run run;
+            run.size = 0;
+
+            if (std::fgetpos(file, &run.position) != 0)
+                break;
+
+            for (auto i = first; i != last; i++)
+                run.size += this->runs[i].size;
+
+            this->merge(first, last, [&](const Record &record) {
+                if (std::fwrite(&record, sizeof(Record), 1, file) != 1)
+                    this->failed = true;
+            });
+            runs.push_back(run);
+        }
+
+        if (file == nullptr || runs.size() * FAN < this->runs.size())
+            this->failed = true;
+
+        std::fclose(this->file);
+        this->file = file;
+        this->runs.swap(runs);
+    }
+
+public:
+    Spill(std::size_t budget, bool (*less)(const Record &, const Record &))
+        : capacity(std::max<std::size_t>(budget / sizeof(Record), 1)),
+          file(nullptr), failed(false), less(less)
+    {
+        this->buffer.reserve(this->capacity);
+    }
+
+    Spill(const Spill &) = delete;
+    Spill &operator=(const Spill &) = delete;
+
+    ~Spill()
+    {
+        if (this->file != nullptr)
+            std::fclose(this->file);
+    }
+
+    void push(const Record &record)
+    {
+        this->buffer.push_back(record);
+
+        if (this->buffer.size() == this->capacity)
+            this->flush();
+    }
+
+    // False when a temporary file could not be made, written or read, in
+    // which case not every record was visited.
+    template <typename Visit>
+    bool drain(Visit visit)
+    {
+        if (this->file == nullptr && !this->failed)
+        {
+            std::sort(this->buffer.begin(), this->buffer.end(), this->less);
+
+            for (std::size_t i = 0; i != this->buffer.size(); i++)
+                visit(this->buffer[i]);
+        }
+        else
+        {
+            if (!this->buffer.empty() && !this->failed)
+                this->flush();
+
+            while (this->runs.size() > FAN && !this->failed)
+                this->pass();
+
+            if (!this->failed)
+                this->merge(0, this->runs.size(), visit);
+        }
+
+        if (this->file != nullptr)
+            std::fclose(this->file);
+
+        this->file = nullptr;
+        this->runs.clear();
+        std::vector<Record>().swap(this->buffer);
+        return !this->failed;
+    }
+};
+
+struct Corner
+{
+    std::size_t vert;
+    std::size_t face;
+    std::size_t corner;
+};
+
+struct Point
+{
+    std::size_t face;
+    std::size_t corner;
+    Vert vert;
+};
+
+struct Half
+{
+    Edge key;
+    Edge edge;
+};
+
+struct Entry
+{
+    Vert vert;
+    std::size_t idx;
+};
+
+static bool parse(const std::string &line, Vert &vert)
+{
+    auto ptr = line.c_str();
+    char *end;
+    vert.x = std::strtod(ptr, &end);
+
+    if (end == ptr || *end != ',')
+        return false;
+
+    vert.y = std::strtod(end + 1, &end);
+
+    if (*end != ',')
+        return false;
+
+    vert.z = std::strtod(end + 1, &end);
+    return true;
+}
+
+static bool parse(const std::string &line, Face &face)
+{
+    auto ptr = line.c_str();
+    char *end;
+    face.v1 = std::strtoull(ptr, &end, 10);
+
+    if (end == ptr || *end != ',')
+        return false;
+
+    face.v2 = std::strtoull(end + 1, &end, 10);
+
+    if (*end != ',')
+        return false;
+
+    face.v3 = std::strtoull(end + 1, &end, 10);
+    return true;
+}
+
+
+// Read-only view of a whole file, mapped instead of read so the parsers
+// below walk the bytes in place.
+class Mapping
+{
+#ifdef __WIN32__
+    HANDLE file;
+    HANDLE handle;
+#endif
+
+public:
+    const char *data;
+    std::size_t size;
+
+    Mapping(const std::string &filename) : data(nullptr), size(0)
+    {
+#ifdef __WIN32__
+        this->file = CreateFileA(filename.c_str(), GENERIC_READ,
+                                 FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                                 FILE_ATTRIBUTE_NORMAL, NULL);
+        this->handle = NULL;
+
+        if (this->file == INVALID_HANDLE_VALUE)
+            return;
+
+        LARGE_INTEGER size;
+
+        if (!GetFileSizeEx(this->file, &size) || size.QuadPart == 0)
+            return;
+
+        this->handle = CreateFileMappingA(this->file, NULL, PAGE_READONLY,
+                                          0, 0, NULL);
+
+        if (this->handle == NULL)
+            return;
+
+        auto base = MapViewOfFile(this->handle, FILE_MAP_READ, 0, 0, 0);
+
+        if (base == NULL)
+            return;
+
+        this->data = static_cast<const char *>(base);
+        this->size = std::size_t(size.QuadPart);
+#else
+        auto fd = open(filename.c_str(), O_RDONLY);
+
+        if (fd < 0)
+            return;
+
+        struct stat info;
+
+        if (fstat(fd, &info) != 0 || info.st_size == 0)
+        {
+            close(fd);
+            return;
+        }
+
+        auto base = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+
+        if (base == MAP_FAILED)
+            return;
+
+        this->data = static_cast<const char *>(base);
+        this->size = info.st_size;
+#endif
+    }
+
+    Mapping(const Mapping &) = delete;
+    Mapping &operator=(const Mapping &) = delete;
+
+    ~Mapping()
+    {
+#ifdef __WIN32__
+        if (this->data != nullptr)
+            UnmapViewOfFile(this->data);
+
+        if (this->handle != NULL)
+            CloseHandle(this->handle);
+
+        if (this->file != INVALID_HANDLE_VALUE)
+            CloseHandle(this->file);
+#else
+        if (this->data != nullptr)
+            munmap(const_cast<char *>(this->data), this->size);
+#endif
+    }
+};
+
+// Binary values are assembled byte by byte in the order the file states,
+// so the host byte order never matters.
+static std::uint64_t bytes(const char *ptr, std::size_t size, bool big)
+{
+    std::uint64_t bits = 0;
+
+    for (std::size_t i = 0; i != size; i++)
+        bits |= std::uint64_t(static_cast<unsigned char>(
+                    ptr[big ? size - 1 - i : i]))
+                << (8 * i);
+
+    return bits;
+}
+
+static double value(const char *ptr, char kind, std::size_t size, bool big)
+{
+    auto bits = bytes(ptr, size, big);
+
+    if (kind == 'f' && size == 4)
+    {
+        auto bits32 = std::uint32_t(bits);
+        float number;
+        std::memcpy(&number, &bits32, sizeof(number));
+        return number;
+    }
+    else if (kind == 'f')
+    {
+        double number;
+        std::memcpy(&number, &bits, sizeof(number));
+        return number;
+    }
+    else if (kind == 'i' && size < 8 && bits >> (8 * size - 1))
+        return double(std::int64_t(bits | ~std::uint64_t(0) << (8 * size)));
+    else
+        return double(bits);
+}
+
+static void put(std::string &buffer, std::uint64_t bits, std::size_t size)
+{
+    for (std::size_t i = 0; i != size; i++)
+        buffer.push_back(char(bits >> (8 * i)));
+}
+
+static void put(std::string &buffer, double number)
+{
+    std::uint64_t bits;
+    std::memcpy(&bits, &number, sizeof(bits));
+    put(buffer, bits, 8);
+}
+
+static void put(std::string &buffer, float number)
+{
+    std::uint32_t bits;
+    std::memcpy(&bits, &number, sizeof(bits));
+    put(buffer, bits, 4);
+}
+
+static bool save(const std::string &buffer, const std::string &filename)
+{
+    auto file = std::fopen(filename.c_str(), "wb");
+
+    if (file == nullptr)
+        return false;
+
+    auto written = std::fwrite(buffer.data(), 1, buffer.size(), file);
+    return std::fclose(file) == 0 && written == buffer.size();
+}
+
+// Vertices in index order and faces renumbered to positions in it, the
+// 0-based layout every exchange format expects.
+static void dense(const Verts &verts, const Faces &faces,
+                  std::vector<Vert> &vectorVerts, std::vector<Face> &vectorFaces)
+{
+    std::vector<std::size_t> vectorIdx(verts.size());
+    vectorVerts.resize(verts.size());
+    vectorFaces.resize(faces.size());
+
+    if (!vectorIdx.empty())
+        verts.copy_all(&vectorIdx[0], &vectorVerts[0]);
+
+    if (!vectorFaces.empty())
+    {
+        std::vector<void *> vectorPtr(faces.size());
+        faces.copy_all(&vectorFaces[0], &vectorPtr[0]);
+    }
+
+    std::vector<std::size_t> map(vectorIdx.empty() ? 0 : vectorIdx.back() + 1,
+                                 -1);
+
+    for (std::size_t i = 0; i != vectorIdx.size(); i++)
+        map[vectorIdx[i]] = i;
+
+    std::size_t size = 0;
+
+    for (std::size_t i = 0; i != vectorFaces.size(); i++)
+    {
+        auto face = vectorFaces[i];
+
+        if (face.v1 < map.size() && face.v2 < map.size() &&
+            face.v3 < map.size() && map[face.v1] != std::size_t(-1) &&
+            map[face.v2] != std::size_t(-1) && map[face.v3] != std::size_t(-1))
+            vectorFaces[size++] = Face(map[face.v1], map[face.v2],
+                                       map[face.v3]);
+    }
+
+    vectorFaces.resize(size);
+}
+
+// Fills empty containers in one deferred pass each, so the secondary
+// indexes are built once by sorting instead of node by node. Containers
+// the caller deferred stay deferred.
+static void build(const std::vector<Vert> &vectorVerts,
+                  const std::vector<Face> &vectorFaces,
+                  Verts &verts, Faces &faces)
+{
+    auto deferredVerts = verts.defer(), deferredFaces = faces.defer();
+    verts.clear();
+    faces.clear();
+    verts.defer(true);
+    faces.defer(true);
+
+    for (std::size_t i = 0; i != vectorVerts.size(); i++)
+        verts.insert(vectorVerts[i]);
+
+    for (std::size_t i = 0; i != vectorFaces.size(); i++)
+        faces.insert(vectorFaces[i], nullptr);
+
+    verts.defer(deferredVerts);
+    faces.defer(deferredFaces);
+}
+
+// True when every face refers to one of the count vertices.
+static bool within(const std::vector<Face> &vectorFaces, std::size_t count)
+{
+    for (std::size_t i = 0; i != vectorFaces.size(); i++)
+        if (vectorFaces[i].v1 >= count || vectorFaces[i].v2 >= count ||
+            vectorFaces[i].v3 >= count)
+            return false;
+
+    return true;
+}
+
+struct Property
+{
+    std::string name;
+    char kind;
+    std::size_t size;
+    char countKind;
+    std::size_t countSize;
+    bool list;
+};
+
+struct Element
+{
+    std::string name;
+    std::size_t count;
+    std::vector<Property> properties;
+};
+
+static bool type(const std::string &name, char &kind, std::size_t &size)
+{
+    static const char *names[] = {"char", "int8", "uchar", "uint8",
+                                  "short", "int16", "ushort", "uint16",
+                                  "int", "int32", "uint", "uint32",
+                                  "float", "float32", "double", "float64"};
+    static const char kinds[] = "iiuuiiuuiiuuffff";
+    static const std::size_t sizes[] = {1, 1, 1, 1, 2, 2, 2, 2,
+                                        4, 4, 4, 4, 4, 4, 8, 8};
+
+    for (std::size_t i = 0; i != 16; i++)
+        if (name == names[i])
+        {
+            kind = kinds[i], size = sizes[i];
+            return true;
+        }
+
+    return false;
+}
+
+void File::read_verts(const std::string &filename, Verts &verts)
+{
+    std::ifstream fin(filename.c_str());
+
+    if (fin.fail())
+        return;
+
+    std::string x, y, z;
+    std::stringstream ss;
+    Vert vert;
+
+    while (!std::getline(fin, x, ',').eof())
+    {
+        std::getline(fin, y, ',');
+        std::getline(fin, z);
+        ss << x, ss >> vert.x, ss.str(""), ss.clear();
+        ss << y, ss >> vert.y, ss.str(""), ss.clear();
+        ss << z, ss >> vert.z, ss.str(""), ss.clear();
+        verts.insert(vert);
+    }
+
+    fin.close();
+}
+
+void File::read_faces(const std::string &filename, Faces &faces)
+{
+    std::ifstream fin(filename.c_str());
+
+    if (fin.fail())
+        return;
+
+    std::string v1, v2, v3;
+    std::stringstream ss;
+    Face face;
+
+    while (!std::getline(fin, v1, ',').eof())
+    {
+        std::getline(fin, v2, ',');
+        std::getline(fin, v3);
+        ss << v1, ss >> face.v1, ss.str(""), ss.clear();
+        ss << v2, ss >> face.v2, ss.str(""), ss.clear();
+        ss << v3, ss >> face.v3, ss.str(""), ss.clear();
+        faces.insert(face, nullptr);
+    }
+
+    fin.close();
+}
+
+
+void File::write_verts(const Verts &verts, const std::string &filename)
+{
+    std::ofstream fout(filename.c_str());
+
+    if (fout.fail())
+        return;
+
+    std::vector<Vert> vector;
+    vector.resize(verts.size());
+    verts.copy_all(&vector[0]);
+
+    for (std::size_t i = 0; i != vector.size(); i++)
+        fout << std::setprecision(15) << vector[i].x << ","
+             << vector[i].y << "," << vector[i].z << "\n";
+
+    fout.close();
+}
+
+void File::write_edges(const Edges &edges, const std::string &filename)
+{
+    std::ofstream fout(filename.c_str());
+
+    if (fout.fail())
+        return;
+
+    std::vector<Edge> vector;
+    vector.resize(edges.size());
+    edges.copy_all(&vector[0]);
+
+    for (std::size_t i = 0; i != vector.size(); i++)
+        fout << vector[i].v1 << "," << vector[i].v2 << "\n";
+
+    fout.close();
+}
+
+void File::write_faces(const Faces &faces, const std::string &filename)
+{
+    std::ofstream fout(filename.c_str());
+
+    if (fout.fail())
+        return;
+
+    std::vector<Face> vectorFaces;
+    std::vector<void *> vectorPtr;
+    vectorFaces.resize(faces.size());
+    vectorPtr.resize(faces.size());
+    faces.copy_all(&vectorFaces[0], &vectorPtr[0]);
+
+    for (std::size_t i = 0; i != vectorFaces.size(); i++)
+        fout << vectorFaces[i].v1 << "," << vectorFaces[i].v2 << ","
+             << vectorFaces[i].v3 << "\n";
+
+    fout.close();
+}
+
+
+bool File::stream_normals(const std::string &filenameVerts,
+                          const std::string &filenameFaces,
+                          const std::string &filename, std::size_t budget)
+{
+    std::ifstream finVerts(filenameVerts.c_str());
+    std::ifstream finFaces(filenameFaces.c_str());
+    std::ofstream fout(filename.c_str());
+
+    if (finVerts.fail() || finFaces.fail() || fout.fail())
+        return false;
+
+    // Every corner is joined with its vertex by sorting the corners by
+    // vertex and walking the vertex file once, then sorted back by face.
+    // Both spills hold their buffers at once, so they share the budget.
+    Spill<Corner> corners(budget / 2, [](const Corner &a, const Corner &b) {
+        return a.vert < b.vert;
+    });
+    Spill<Point> points(budget / 2, [](const Point &a, const Point &b) {
+        return a.face != b.face ? a.face < b.face : a.corner < b.corner;
+    });
+    std::string line;
+    std::size_t count = 0;
+    Face face;
+
+    while (std::getline(finFaces, line))
+        if (parse(line, face))
+        {
+            corners.push(Corner{face.v1, count, 0});
+            corners.push(Corner{face.v2, count, 1});
+            corners.push(Corner{face.v3, count, 2});
+            count++;
+        }
+
+    std::size_t idx = 0;
+    bool valid = false;
+    Vert vert;
+
+    auto drained = corners.drain([&](const Corner &corner) {
+        while (idx <= corner.vert && std::getline(finVerts, line))
+            if (parse(line, vert))
+                valid = idx++ == corner.vert;
+
+        if (valid && idx == corner.vert + 1)
+            points.push(Point{corner.face, corner.corner, vert});
+    });
+
+    Point group[3];
+    std::size_t size = 0, next = 0;
+
+    auto write = [&](std::size_t face) {
+        for (; next < face; next++)
+            fout << "0,0,0\n";
+    };
+
+    auto emit = [&]() {
+        if (size != 3 || group[0].corner != 0 || group[1].corner != 1)
+            return;
+
+        auto a = group[0].vert, b = group[1].vert, c = group[2].vert;
+        auto x = (b.y - a.y) * (c.z - a.z) - (b.z - a.z) * (c.y - a.y);
+        auto y = (b.z - a.z) * (c.x - a.x) - (b.x - a.x) * (c.z - a.z);
+        auto z = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+        auto length = std::sqrt(x * x + y * y + z * z);
+
+        if (length == 0)
+            return;
+
+        write(group[0].face);
+        fout << std::setprecision(15) << x / length << "," << y / length
+             << "," << z / length << "\n";
+        next++;
+    };
+
+    drained = points.drain([&](const Point &point) {
+        if (size != 0 && group[0].face != point.face)
+        {
+            emit();
+            size = 0;
+        }
+
+        if (size < 3)
+            group[size++] = point;
+    }) && drained;
+
+    emit();
+    write(count);
+    fout.close();
+    return drained && !fout.fail();
+}
+
+bool File::stream_boundary(const std::string &filenameFaces,
+                           const std::string &filename, std::size_t budget)
+{
+    std::ifstream fin(filenameFaces.c_str());
+    std::ofstream fout(filename.c_str());
+
+    if (fin.fail() || fout.fail())
+        return false;
+
+    Spill<Half> halves(budget, [](const Half &a, const Half &b) {
+        return a.key < b.key;
+    });
+    std::string line;
+    Face face;
+
+    while (std::getline(fin, line))
+        if (parse(line, face))
+        {
+            Edge edges[3] = {Edge(face.v1, face.v2), Edge(face.v2, face.v3),
+                             Edge(face.v3, face.v1)};
+
+            for (int i = 0; i != 3; i++)
+                halves.push(Half{Edge(std::min(edges[i].v1, edges[i].v2),
+                                      std::max(edges[i].v1, edges[i].v2)),
+                                 edges[i]});
+        }
+
+    // Boundary edges are the keys that occur exactly once, written in the
+    // winding of their face.
+    Half last;
+    std::size_t size = 0;
+
+    auto drained = halves.drain([&](const Half &half) {
+        if (size != 0 && !(last.key == half.key))
+        {
+            if (size == 1)
+                fout << last.edge.v1 << "," << last.edge.v2 << "\n";
+
+            size = 0;
+        }
+
+        last = half;
+        size++;
+    });
+
+    if (size == 1)
+        fout << last.edge.v1 << "," << last.edge.v2 << "\n";
+
+    fout.close();
+    return drained && !fout.fail();
+}
+
+bool File::stream_weld(const std::string &filenameVerts,
+                       const std::string &filenameFaces,
+                       const std::string &filenameVertsOut,
+                       const std::string &filenameFacesOut,
+                       std::size_t budget)
+{
+    std::ifstream finVerts(filenameVerts.c_str());
+    std::ifstream finFaces(filenameFaces.c_str());
+    std::ofstream foutVerts(filenameVertsOut.c_str());
+    std::ofstream foutFaces(filenameFacesOut.c_str());
+
+    if (finVerts.fail() || finFaces.fail() || foutVerts.fail() ||
+        foutFaces.fail())
+        return false;
+
+    // Identical coordinates become one vertex, numbered in coordinate
+    // order, and the old to new map is sorted by old index so that the
+    // faces can be joined against it like in stream_normals. The 4 spills
+    // hold their buffers at once, so they share the budget.
+    Spill<Entry> entries(budget / 4, [](const Entry &a, const Entry &b) {
+        return a.vert == b.vert ? a.idx < b.idx : a.vert < b.vert;
+    });
+    Spill<Edge> maps(budget / 4, [](const Edge &a, const Edge &b) {
+        return a.v1 < b.v1;
+    });
+    Spill<Corner> corners(budget / 4, [](const Corner &a, const Corner &b) {
+        return a.vert < b.vert;
+    });
+    Spill<Corner> slots(budget / 4, [](const Corner &a, const Corner &b) {
+        return a.face != b.face ? a.face < b.face : a.corner < b.corner;
+    });
+    std::string line;
+    std::size_t idx = 0;
+    Vert vert;
+    Face face;
+
+    while (std::getline(finVerts, line))
+        if (parse(line, vert))
+        {
+            entries.push(Entry{vert, idx});
+            idx++;
+        }
+
+    std::size_t count = 0;
+    Vert last;
+
+    auto drained = entries.drain([&](const Entry &entry) {
+        if (count == 0 || !(last == entry.vert))
+        {
+            foutVerts << std::setprecision(15) << entry.vert.x << ","
+                      << entry.vert.y << "," << entry.vert.z << "\n";
+            last = entry.vert;
+            count++;
+        }
+
+        maps.push(Edge(entry.idx, count - 1));
+    });
+
+    std::size_t number = 0;
+
+    while (std::getline(finFaces, line))
+        if (parse(line, face))
+        {
+            corners.push(Corner{face.v1, number, 0});
+            corners.push(Corner{face.v2, number, 1});
+            corners.push(Corner{face.v3, number, 2});
+            number++;
+        }
+
+    // The sorted map is spilled once more so that it can be read back in
+    // step with the corners while they merge.
+    auto file = std::tmpfile();
+
+    if (file == nullptr)
+        return false;
+
+    Edge map(0, 0);
+    bool valid = false, written = true;
+
+    drained = maps.drain([&](const Edge &edge) {
+        written = written && std::fwrite(&edge, sizeof(Edge), 1, file) == 1;
+    }) && drained && written;
+    std::rewind(file);
+
+    drained = corners.drain([&](const Corner &corner) {
+        while ((!valid || map.v1 < corner.vert) &&
+               std::fread(&map, sizeof(Edge), 1, file) == 1)
+            valid = true;
+
+        if (valid && map.v1 == corner.vert)
+            slots.push(Corner{map.v2, corner.face, corner.corner});
+    }) && drained && std::ferror(file) == 0;
+
+    std::fclose(file);
+
+    Corner group[3];
+    std::size_t size = 0;
+
+    auto emit = [&]() {
+        if (size != 3 || group[0].corner != 0 || group[1].corner != 1 ||
+            group[0].vert == group[1].vert || group[1].vert == group[2].vert ||
+            group[2].vert == group[0].vert)
+            return;
+
+        foutFaces << group[0].vert << "," << group[1].vert << ","
+                  << group[2].vert << "\n";
+    };
+
+    drained = slots.drain([&](const Corner &corner) {
+        if (size != 0 && group[0].face != corner.face)
+        {
+            emit();
+            size = 0;
+        }
+
+        if (size < 3)
+            group[size++] = corner;
+    }) && drained;
+
+    emit();
+    foutVerts.close();
+    foutFaces.close();
+    return drained && !foutVerts.fail() && !foutFaces.fail();
+}
+
+
+bool File::read_ply(const std::string &filename, Verts &verts, Faces &faces)
+{
+    Mapping mapping(filename);
+    auto ptr = mapping.data, end = mapping.data + mapping.size;
+
+    if (ptr == nullptr)
+        return false;
+
+    // The header is short text, everything after it is walked in place.
+    std::vector<Element> elements;
+    std::string line, token;
+    auto big = false, binary = false, first = true;
+
+    while (true)
+    {
+        auto next = static_cast<const char *>(std::memchr(ptr, '\n', end - ptr));
+
+        if (next == nullptr)
+            return false;
+
+        line.assign(ptr, next);
+        ptr = next + 1;
+
+        if (!line.empty() && line[line.size() - 1] == '\r')
+            line.erase(line.size() - 1);
+
+        if (first)
+        {
+            if (line != "ply")
+                return false;
+
+            first = false;
+            continue;
+        }
+
+        std::istringstream ss(line);
+        ss >> token;
+
+        if (token == "end_header")
+            break;
+        else if (token == "format")
+        {
+            ss >> token;
+            binary = token == "binary_little_endian" ||
+                     token == "binary_big_endian";
+            big = token == "binary_big_endian";
+        }
+        else if (token == "element")
+        {
+            Element element;
+            ss >> element.name >> element.count;
+            elements.push_back(element);
+        }
+        else if (token == "property" && !elements.empty())
+        {
+            Property property;
+            property.list = false;
+            ss >> token;
+
+            if (token == "list")
+            {
+                property.list = true;
+                ss >> token;
+
+                if (!type(token, property.countKind, property.countSize))
+                    return false;
+
+                ss >> token;
+            }
+
+            if (!type(token, property.kind, property.size))
+                return false;
+
+            ss >> property.name;
+            elements.back().properties.push_back(property);
+        }
+    }
+
+    if (!binary)
+        return false;
+
+    std::vector<Vert> vectorVerts;
+    std::vector<Face> vectorFaces;
+    std::vector<std::size_t> polygon;
+
+    for (std::size_t e = 0; e != elements.size(); e++)
+    {
+        auto &element = elements[e];
+        auto isVertex = element.name == "vertex";
+        auto isFace = element.name == "face";
+
+        if (isVertex)
+            vectorVerts.reserve(element.count);
+
+        for (std::size_t i = 0; i != element.count; i++)
+        {
+            Vert vert(0, 0, 0);
+
+            for (std::size_t p = 0; p != element.properties.size(); p++)
+            {
+                auto &property = element.properties[p];
+
+                if (!property.list)
+                {
+                    if (std::size_t(end - ptr) < property.size)
+                        return false;
+
+                    auto number = value(ptr, property.kind, property.size, big);
+                    ptr += property.size;
+
+                    if (isVertex && property.name == "x")
+                        vert.x = number;
+                    else if (isVertex && property.name == "y")
+                        vert.y = number;
+                    else if (isVertex && property.name == "z")
+                        vert.z = number;
+
+                    continue;
+                }
+
+                if (std::size_t(end - ptr) < property.countSize)
+                    return false;
+
+                // Signed counts and indices may be negative, which has no
+                // size_t value, and a double past 2^53 is no exact index.
+                auto LIMIT = 9007199254740992.0;
+                auto number = value(ptr, property.countKind,
+                                    property.countSize, big);
+                ptr += property.countSize;
+
+                if (!(number >= 0 && number < LIMIT) ||
+                    number != std::floor(number) ||
+                    std::size_t(end - ptr) / property.size <
+                        std::size_t(number))
+                    return false;
+
+                auto count = std::size_t(number);
+
+                auto indices = isFace && (property.name == "vertex_indices" ||
+                                          property.name == "vertex_index");
+                polygon.clear();
+
+                for (std::size_t k = 0; k != count; k++, ptr += property.size)
+                    if (indices)
+                    {
+                        number = value(ptr, property.kind, property.size, big);
+
+                        if (!(number >= 0 && number < LIMIT) ||
+                            number != std::floor(number))
+                            return false;
+
+                        polygon.push_back(std::size_t(number));
+                    }
+
+                // Polygons are split into a fan around their first corner.
+                for (std::size_t k = 1; k + 1 < polygon.size(); k++)
+                    vectorFaces.push_back(Face(polygon[0], polygon[k],
+                                               polygon[k + 1]));
+            }
+
+            if (isVertex)
+                vectorVerts.push_back(vert);
+        }
+    }
+
+    if (!within(vectorFaces, vectorVerts.size()))
+        return false;
+
+    build(vectorVerts, vectorFaces, verts, faces);
+    return true;
+}
+
+bool File::read_stl(const std::string &filename, Verts &verts, Faces &faces)
+{
+    Mapping mapping(filename);
+
+    if (mapping.data == nullptr || mapping.size < 84)
+        return false;
+
+    // Some writers pad the file after the last triangle.
+    auto count = std::size_t(bytes(mapping.data + 80, 4, false));
+
+    if ((mapping.size - 84) / 50 < count)
+        return false;
+
+    // Every corner carries its own coordinates. Sorting the corners brings
+    // equal positions together, and each position becomes one vertex
+    // numbered by its first corner, which keeps the file order.
+    std::vector<std::pair<Vert, std::size_t>> corners(3 * count);
+
+    for (std::size_t i = 0; i != count; i++)
+    {
+        auto ptr = mapping.data + 84 + 50 * i + 12;
+
+        for (std::size_t j = 0; j != 3; j++, ptr += 12)
+            corners[3 * i + j] = std::pair<Vert, std::size_t>(
+                Vert(value(ptr, 'f', 4, false), value(ptr + 4, 'f', 4, false),
+                     value(ptr + 8, 'f', 4, false)),
+                3 * i + j);
+    }
+
+    std::sort(corners.begin(), corners.end());
+
+    std::vector<std::size_t> leader(3 * count);
+
+    for (std::size_t i = 0; i != corners.size(); i++)
+        leader[corners[i].second] =
+            i != 0 && corners[i].first == corners[i - 1].first
+                ? leader[corners[i - 1].second]
+                : corners[i].second;
+
+    std::vector<Vert> vectorVerts;
+    std::vector<std::size_t> map(3 * count, -1);
+    std::vector<Face> vectorFaces(count);
+
+    for (std::size_t i = 0; i != 3 * count; i++)
+        if (leader[i] == i)
+        {
+            auto ptr = mapping.data + 84 + 50 * (i / 3) + 12 + 12 * (i % 3);
+            map[i] = vectorVerts.size();
+            vectorVerts.push_back(Vert(value(ptr, 'f', 4, false),
+                                       value(ptr + 4, 'f', 4, false),
+                                       value(ptr + 8, 'f', 4, false)));
+        }
+
+    for (std::size_t i = 0; i != count; i++)
+        vectorFaces[i] = Face(map[leader[3 * i]], map[leader[3 * i + 1]],
+                              map[leader[3 * i + 2]]);
+
+    build(vectorVerts, vectorFaces, verts, faces);
+    return true;
+}
+
+bool File::read_obj(const std::string &filename, Verts &verts, Faces &faces)
+{
+    Mapping mapping(filename);
+    auto ptr = mapping.data, end = mapping.data + mapping.size;
+
+    if (ptr == nullptr)
+        return false;
+
+    std::vector<Vert> vectorVerts;
+    std::vector<Face> vectorFaces;
+    std::vector<std::size_t> polygon;
+    std::string line;
+
+    // Lines are copied into one reused buffer, which gives strtod and
+    // strtoll the terminator a mapping does not have.
+    while (ptr != end)
+    {
+        auto next = static_cast<const char *>(std::memchr(ptr, '\n', end - ptr));
+
+        if (next == nullptr)
+            next = end;
+
+        line.assign(ptr, next);
+        ptr = next == end ? end : next + 1;
+
+        auto text = line.c_str();
+        char *stop;
+
+        if (text[0] == 'v' && (text[1] == ' ' || text[1] == '\t'))
+        {
+            Vert vert;
+            vert.x = std::strtod(text + 2, &stop);
+            vert.y = std::strtod(stop, &stop);
+            vert.z = std::strtod(stop, &stop);
+            vectorVerts.push_back(vert);
+        }
+        else if (text[0] == 'f' && (text[1] == ' ' || text[1] == '\t'))
+        {
+            polygon.clear();
+            text += 2;
+
+            while (true)
+            {
+                auto idx = std::strtoll(text, &stop, 10);
+
+                if (stop == text)
+                    break;
+
+                // Negative indices count back from the latest vertex, and
+                // positive ones are checked once every vertex is read.
+                if (idx == 0 || (idx < 0 && std::size_t(-(idx + 1)) >=
+                                                vectorVerts.size()))
+                    return false;
+
+                polygon.push_back(idx < 0 ? vectorVerts.size() + idx
+                                          : std::size_t(idx - 1));
+
+                for (text = stop; *text != '\0' && *text != ' ' &&
+                                  *text != '\t';
+                     text++)
+                    ;
+            }
+
+            for (std::size_t k = 1; k + 1 < polygon.size(); k++)
+                vectorFaces.push_back(Face(polygon[0], polygon[k],
+                                           polygon[k + 1]));
+        }
+    }
+
+    if (!within(vectorFaces, vectorVerts.size()))
+        return false;
+
+    build(vectorVerts, vectorFaces, verts, faces);
+    return true;
+}
+
+
+bool File::write_ply(const Verts &verts, const Faces &faces,
+                     const std::string &filename)
+{
+    std::vector<Vert> vectorVerts;
+    std::vector<Face> vectorFaces;
+    dense(verts, faces, vectorVerts, vectorFaces);
+
+    std::ostringstream header;
+    header << "ply\nformat binary_little_endian 1.0\n"
+           << "element vertex " << vectorVerts.size() << "\n"
+           << "property double x\nproperty double y\nproperty double z\n"
+           << "element face " << vectorFaces.size() << "\n"
+           << "property list uchar uint vertex_indices\nend_header\n";
+
+    auto buffer = header.str();
+    buffer.reserve(buffer.size() + 24 * vectorVerts.size() +
+                   13 * vectorFaces.size());
+
+    for (std::size_t i = 0; i != vectorVerts.size(); i++)
+    {
+        put(buffer, vectorVerts[i].x);
+        put(buffer, vectorVerts[i].y);
+        put(buffer, vectorVerts[i].z);
+    }
+
+    for (std::size_t i = 0; i != vectorFaces.size(); i++)
+    {
+        put(buffer, 3, 1);
+        put(buffer, vectorFaces[i].v1, 4);
+        put(buffer, vectorFaces[i].v2, 4);
+        put(buffer, vectorFaces[i].v3, 4);
+    }
+
+    return save(buffer, filename);
+}
+
+bool File::write_stl(const Verts &verts, const Faces &faces,
+                     const std::string &filename)
+{
+    std::vector<Vert> vectorVerts;
+    std::vector<Face> vectorFaces;
+    dense(verts, faces, vectorVerts, vectorFaces);
+
+    std::string buffer(80, ' ');
+    buffer.replace(0, 10, "binary STL");
+    buffer.reserve(84 + 50 * vectorFaces.size());
+    put(buffer, vectorFaces.size(), 4);
+
+    for (std::size_t i = 0; i != vectorFaces.size(); i++)
+    {
+        auto a = vectorVerts[vectorFaces[i].v1];
+        auto b = vectorVerts[vectorFaces[i].v2];
+        auto c = vectorVerts[vectorFaces[i].v3];
+        auto nx = (b.y - a.y) * (c.z - a.z) - (b.z - a.z) * (c.y - a.y);
+        auto ny = (b.z - a.z) * (c.x - a.x) - (b.x - a.x) * (c.z - a.z);
+        auto nz = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+        auto norm = std::sqrt(nx * nx + ny * ny + nz * nz);
+
+        if (norm != 0)
+            nx /= norm, ny /= norm, nz /= norm;
+
+        Vert corners[4] = {Vert(nx, ny, nz), a, b, c};
+
+        for (std::size_t j = 0; j != 4; j++)
+        {
+            put(buffer, float(corners[j].x));
+            put(buffer, float(corners[j].y));
+            put(buffer, float(corners[j].z));
+        }
+
+        put(buffer, 0, 2);
+    }
+
+    return save(buffer, filename);
+}
+
+bool File::write_obj(const Verts &verts, const Faces &faces,
+                     const std::string &filename)
+{
+    std::vector<Vert> vectorVerts;
+    std::vector<Face> vectorFaces;
+    dense(verts, faces, vectorVerts, vectorFaces);
+
+    std::string buffer;
+    char line[128];
+
+    for (std::size_t i = 0; i != vectorVerts.size(); i++)
+        buffer.append(line, std::snprintf(line, sizeof(line),
+                                          "v %.17g %.17g %.17g\n",
+                                          vectorVerts[i].x, vectorVerts[i].y,
+                                          vectorVerts[i].z));
+
+    for (std::size_t i = 0; i != vectorFaces.size(); i++)
+        buffer.append(line, std::snprintf(
+                                line, sizeof(line), "f %llu %llu %llu\n",
+                                (unsigned long long)vectorFaces[i].v1 + 1,
+                                (unsigned long long)vectorFaces[i].v2 + 1,
+                                (unsigned long long)vectorFaces[i].v3 + 1));
+
+    return save(buffer, filename);
+}
@@ -1,30 +1,46 @@
-#ifndef FILE_H
-#define FILE_H
-
-#ifdef __WIN32__
-#ifdef BUILD_LIB
-#define LIB_CLASS __declspec(dllexport)
-#else
-#define LIB_CLASS __declspec(dllimport)
-#endif
-#else
-#define LIB_CLASS
-#endif
-
-#include "mesh.h"
-#include <string>
-
-
-class LIB_CLASS File
-{
-public:
-    static void read_verts(const std::string &, Verts &);
-    static void read_faces(const std::string &, Faces &);
-
-    static void write_verts(const Verts &, const std::string &);
-    static void write_edges(const Edges &, const std::string &);
-    static void write_faces(const Faces &, const std::string &);
-};
-
-
-#endif
\ No newline at end of file
+#ifndef FILE_H
+#define FILE_H
+
+#ifdef __WIN32__
+#ifdef BUILD_LIB
+#define LIB_CLASS __declspec(dllexport)
+#else
+#define LIB_CLASS __declspec(dllimport)
+#endif
+#else
+#define LIB_CLASS
+#endif
+
+#include "mesh.h"
+#include <string>
+
+
+class LIB_CLASS File
+{
+public:
+    static void read_verts(const std::string &, Verts &);
+    static void read_faces(const std::string &, Faces &);
+
+    static void write_verts(const Verts &, const std::string &);
+    static void write_edges(const Edges &, const std::string &);
+    static void write_faces(const Faces &, const std::string &);
+
+    static bool read_ply(const std::string &, Verts &, Faces &);
+    static bool read_stl(const std::string &, Verts &, Faces &);
+    static bool read_obj(const std::string &, Verts &, Faces &);
+
+    static bool write_ply(const Verts &, const Faces &, const std::string &);
+    static bool write_stl(const Verts &, const Faces &, const std::string &);
+    static bool write_obj(const Verts &, const Faces &, const std::string &);
+
+    static bool stream_normals(const std::string &, const std::string &,
+                               const std::string &, std::size_t);
+    static bool stream_boundary(const std::string &, const std::string &,
+                                std::size_t);
+    static bool stream_weld(const std::string &, const std::string &,
+                            const std::string &, const std::string &,
+                            std::size_t);
+};
+
+
+#endif
@@ -0,0 +1,2312 @@
+#include "geom.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <queue>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define GEOM_SSE2
+#endif
+
+
+static std::uint64_t spread(std::uint64_t bits)
+{
+    bits &= 0x1fffff;
+    bits = (bits | bits << 32) & 0x1f00000000ffffull;
+    bits = (bits | bits << 16) & 0x1f0000ff0000ffull;
+    bits = (bits | bits << 8) & 0x100f00f00f00f00full;
+    bits = (bits | bits << 4) & 0x10c30c30c30c30c3ull;
+    bits = (bits | bits << 2) & 0x1249249249249249ull;
+    return bits;
+}
+
+// Number of bits up to and including the highest set one.
+static std::size_t bit_length(std::uint64_t bits)
+{
+    if (bits == 0)
+        return 0;
+
+#if defined(__GNUC__)
+    return 64 - __builtin_clzll(bits);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long idx;
+    _BitScanReverse64(&idx, bits);
+    return idx + 1;
+#else
+    std::size_t length = 0;
+
+    for (std::size_t shift = 32; shift != 0; shift /= 2)
+        if (bits >> shift != 0)
+        {
+            bits >>= shift;
+            length += shift;
+        }
+
+    return length + 1;
+#endif
+}
+
+
+// Neumaier summation. Partial sums are kept per fixed size block and
+// added in block order, so the result does not depend on the thread count.
+struct Sum
+{
+    double sum;
+    double comp;
+
+    Sum() : sum(0), comp(0) {}
+
+    void add(double value)
+    {
+        auto total = this->sum + value;
+
+        if (std::abs(this->sum) >= std::abs(value))
+            this->comp += (this->sum - total) + value;
+        else
+            this->comp += (value - total) + this->sum;
+
+        this->sum = total;
+    }
+
+    // Adds an array in 2 lanes with Knuth's TwoSum, which needs no branch
+    // and runs as SSE2 where available. Both paths add in the same order
+    // and give the same result.
+    void add(const double *values, std::size_t size)
+    {
+        auto pairs = size / 2;
+        double lanes[4] = {0, 0, 0, 0};
+
+#ifdef GEOM_SSE2
+        auto sums = _mm_setzero_pd(), comps = _mm_setzero_pd();
+
+        for (std::size_t i = 0; i != pairs; i++)
+        {
+            auto value = _mm_loadu_pd(values + 2 * i);
+            auto total = _mm_add_pd(sums, value);
+            auto part = _mm_sub_pd(total, sums);
+            comps = _mm_add_pd(
+                comps, _mm_add_pd(_mm_sub_pd(sums, _mm_sub_pd(total, part)),
+                                  _mm_sub_pd(value, part)));
+            sums = total;
+        }
+
+        _mm_storeu_pd(lanes, sums);
+        _mm_storeu_pd(lanes + 2, comps);
+#else
+        for (std::size_t i = 0; i != pairs; i++)
+            for (std::size_t j = 0; j != 2; j++)
+            {
+                auto value = values[2 * i + j];
+                auto total = lanes[j] + value;
+                auto part = total - lanes[j];
+                lanes[2 + j] += (lanes[j] - (total - part)) + (value - part);
+                lanes[j] = total;
+            }
+#endif
+
+        for (std::size_t j = 0; j != 4; j++)
+            this->add(lanes[j]);
+
+        if (size % 2 != 0)
+            this->add(values[size - 1]);
+    }
+
+    double value() const
+    {
+        return this->sum + this->comp;
+    }
+};
+
+static const std::size_t BLOCK = 4096;
+
+static bool finite(const Vert &vert)
+{
+    return std::isfinite(vert.x) && std::isfinite(vert.y) &&
+           std::isfinite(vert.z);
+}
+
+// Lowest and highest coordinates of an array of vertices, taken 2 at a
+// time as 3 pairs of doubles where SSE2 is available.
+static void extremes(const Vert *vector, std::size_t size,
+                     Vert &low, Vert &up)
+{
+    std::size_t i = 0;
+
+#ifdef GEOM_SSE2
+    static_assert(sizeof(Vert) == 3 * sizeof(double), "Vert is 3 doubles");
+    auto coords = reinterpret_cast<const double *>(vector);
+    __m128d lows[3] = {_mm_set_pd(low.y, low.x), _mm_set_pd(low.x, low.z),
+                       _mm_set_pd(low.z, low.y)};
+    __m128d ups[3] = {_mm_set_pd(up.y, up.x), _mm_set_pd(up.x, up.z),
+                      _mm_set_pd(up.z, up.y)};
+
+    for (; i + 2 <= size; i += 2)
+        for (std::size_t k = 0; k != 3; k++)
+        {
+            auto value = _mm_loadu_pd(coords + 3 * i + 2 * k);
+            lows[k] = _mm_min_pd(value, lows[k]);
+            ups[k] = _mm_max_pd(value, ups[k]);
+        }
+
+    double lanes[12];
+
+    for (std::size_t k = 0; k != 3; k++)
+    {
+        _mm_storeu_pd(lanes + 2 * k, lows[k]);
+        _mm_storeu_pd(lanes + 6 + 2 * k, ups[k]);
+    }
+
+    low = Vert(std::min(lanes[0], lanes[3]), std::min(lanes[1], lanes[4]),
+               std::min(lanes[2], lanes[5]));
+    up = Vert(std::max(lanes[6], lanes[9]), std::max(lanes[7], lanes[10]),
+              std::max(lanes[8], lanes[11]));
+#endif
+
+    for (; i != size; i++)
+    {
+        low.x = std::min(low.x, vector[i].x);
+        low.y = std::min(low.y, vector[i].y);
+        low.z = std::min(low.z, vector[i].z);
+        up.x = std::max(up.x, vector[i].x);
+        up.y = std::max(up.y, vector[i].y);
+        up.z = std::max(up.z, vector[i].z);
+    }
+}
+static const double PI = 3.14159265358979323846;
+
+static std::vector<Vert> flatten(const Verts &verts)
+{
+    std::vector<Vert> vector;
+
+    if (verts.size() == 0)
+        return vector;
+
+    std::vector<std::size_t> vectorIdx(verts.size());
+    std::vector<Vert> vectorVerts(verts.size());
+    verts.copy_all(&vectorIdx[0], &vectorVerts[0]);
+
+    auto INF = std::numeric_limits<double>::infinity();
+    vector.assign(vectorIdx.back() + 1, Vert(INF, INF, INF));
+
+    for (std::size_t i = 0; i != vectorIdx.size(); i++)
+        vector[vectorIdx[i]] = vectorVerts[i];
+
+    return vector;
+}
+
+static std::vector<Face> flatten(const Faces &faces)
+{
+    std::vector<Face> vectorFaces(faces.size());
+    std::vector<void *> vectorPtr(faces.size());
+
+    if (!vectorFaces.empty())
+        faces.copy_all(&vectorFaces[0], &vectorPtr[0]);
+
+    return vectorFaces;
+}
+
+
+// Symmetric 4x4 error quadric stored as its upper triangle.
+struct Quadric
+{
+    double m[10];
+
+    Quadric()
+    {
+        std::fill(this->m, this->m + 10, 0.0);
+    }
+
+    Quadric(double a, double b, double c, double d, double w)
+    {
+        this->m[0] = w * a * a, this->m[1] = w * a * b;
+        this->m[2] = w * a * c, this->m[3] = w * a * d;
+        this->m[4] = w * b * b, this->m[5] = w * b * c;
+        this->m[6] = w * b * d, this->m[7] = w * c * c;
+        this->m[8] = w * c * d, this->m[9] = w * d * d;
+    }
+
+    void add(const Quadric &other)
+    {
+        for (int i = 0; i != 10; i++)
+            this->m[i] += other.m[i];
+    }
+
+    double error(const Vert &vert) const
+    {
+        auto x = vert.x, y = vert.y, z = vert.z;
+        auto e = this->m[0] * x * x + 2 * this->m[1] * x * y +
+                 2 * this->m[2] * x * z + 2 * this->m[3] * x +
+                 this->m[4] * y * y + 2 * this->m[5] * y * z +
+                 2 * this->m[6] * y + this->m[7] * z * z +
+                 2 * this->m[8] * z + this->m[9];
+        return std::max(e, 0.0);
+    }
+
+    bool optimum(Vert &vert) const
+    {
+        auto a = this->m[0], b = this->m[1], c = this->m[2];
+        auto d = this->m[4], e = this->m[5], f = this->m[7];
+        auto det = a * (d * f - e * e) - b * (b * f - c * e) +
+                   c * (b * e - c * d);
+
+        if (std::abs(det) < 1e-12 * (a * a * a + d * d * d + f * f * f))
+            return false;
+
+        auto x = -this->m[3], y = -this->m[6], z = -this->m[8];
+        vert.x = (x * (d * f - e * e) - b * (y * f - e * z) +
+                  c * (y * e - d * z)) / det;
+        vert.y = (a * (y * f - e * z) - x * (b * f - c * e) +
+                  c * (b * z - y * c)) / det;
+        vert.z = (a * (d * z - y * e) - b * (b * z - y * c) +
+                  x * (b * e - c * d)) / det;
+        return true;
+    }
+};
+
+struct Collapse
+{
+    double cost;
+    std::size_t u;
+    std::size_t v;
+    std::size_t time;
+
+    bool operator<(const Collapse &other) const
+    {
+        return this->cost > other.cost;
+    }
+};
+
+// Monotone priority queue for non-negative doubles. Their bit patterns
+// order like the values, and every key lands in the bucket of the highest
+// bit where it differs from the last minimum, so a push is constant time
+// and a pop only redistributes one bucket.
+struct RadixHeap
+{
+    std::vector<std::pair<std::uint64_t, std::size_t>> buckets[65];
+    std::uint64_t last;
+    std::size_t count;
+
+    RadixHeap() : last(0), count(0) {}
+
+    static std::uint64_t key(double value)
+    {
+        std::uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    std::size_t bucket(std::uint64_t key) const
+    {
+        return bit_length(key ^ this->last);
+    }
+
+    void push(double value, std::size_t idx)
+    {
+        auto bits = std::max(key(value), this->last);
+        this->buckets[this->bucket(bits)].push_back(
+            std::pair<std::uint64_t, std::size_t>(bits, idx));
+        this->count++;
+    }
+
+    bool empty() const
+    {
+        return this->count == 0;
+    }
+
+    std::pair<std::uint64_t, std::size_t> pop()
+    {
+        if (this->buckets[0].empty())
+        {
+            std::size_t i = 1;
+
+            while (this->buckets[i].empty())
+                i++;
+
+            auto &from = this->buckets[i];
+            this->last = from[0].first;
+
+            for (std::size_t j = 1; j != from.size(); j++)
+                this->last = std::min(this->last, from[j].first);
+
+            for (std::size_t j = 0; j != from.size(); j++)
+                this->buckets[this->bucket(from[j].first)].push_back(from[j]);
+
+            from.clear();
+        }
+
+        auto top = this->buckets[0].back();
+        this->buckets[0].pop_back();
+        this->count--;
+        return top;
+    }
+};
+
+// Vertex adjacency in compressed rows: the neighbors of v are
+// neighbors[offsets[v]] to neighbors[offsets[v + 1]], sorted and unique.
+static void adjacency(const std::vector<Face> &faces, std::size_t count,
+                      std::vector<std::size_t> &offsets,
+                      std::vector<std::size_t> &neighbors)
+{
+    offsets.assign(count + 1, 0);
+
+    for (std::size_t i = 0; i != faces.size(); i++)
+    {
+        offsets[faces[i].v1 + 1] += 2;
+        offsets[faces[i].v2 + 1] += 2;
+        offsets[faces[i].v3 + 1] += 2;
+    }
+
+    for (std::size_t i = 0; i != count; i++)
+        offsets[i + 1] += offsets[i];
+
+    neighbors.resize(offsets[count]);
+    std::vector<std::size_t> fill(offsets.begin(), offsets.end() - 1);
+
+    for (std::size_t i = 0; i != faces.size(); i++)
+    {
+        auto face = faces[i];
+        neighbors[fill[face.v1]++] = face.v2;
+        neighbors[fill[face.v1]++] = face.v3;
+        neighbors[fill[face.v2]++] = face.v3;
+        neighbors[fill[face.v2]++] = face.v1;
+        neighbors[fill[face.v3]++] = face.v1;
+        neighbors[fill[face.v3]++] = face.v2;
+    }
+
+    parallel_for(count, 4096, [&](std::size_t begin, std::size_t end) {
+        for (auto v = begin; v != end; v++)
+        {
+            auto first = neighbors.begin() + offsets[v];
+            auto last = neighbors.begin() + offsets[v + 1];
+            std::sort(first, last);
+            fill[v] = std::unique(first, last) - first;
+        }
+    });
+
+    std::size_t size = 0;
+
+    for (std::size_t v = 0; v != count; v++)
+    {
+        auto first = offsets[v];
+        offsets[v] = size;
+
+        for (std::size_t i = 0; i != fill[v]; i++)
+            neighbors[size++] = neighbors[first + i];
+    }
+
+    offsets[count] = size;
+    neighbors.resize(size);
+}
+
+static Vert cross(const Vert &a, const Vert &b, const Vert &c)
+{
+    return Vert((b.y - a.y) * (c.z - a.z) - (b.z - a.z) * (c.y - a.y),
+                (b.z - a.z) * (c.x - a.x) - (b.x - a.x) * (c.z - a.z),
+                (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x));
+}
+
+// Orientation of d against the plane through a, b and c. The double
+// result is trusted when it clears the static error bound, otherwise the
+// determinant is evaluated again in extended precision.
+static int orient(const Vert &a, const Vert &b, const Vert &c, const Vert &d)
+{
+    auto adx = a.x - d.x, ady = a.y - d.y, adz = a.z - d.z;
+    auto bdx = b.x - d.x, bdy = b.y - d.y, bdz = b.z - d.z;
+    auto cdx = c.x - d.x, cdy = c.y - d.y, cdz = c.z - d.z;
+    auto det = adx * (bdy * cdz - bdz * cdy) + bdx * (cdy * adz - cdz * ady) +
+               cdx * (ady * bdz - adz * bdy);
+    auto permanent =
+        std::abs(adx) * (std::abs(bdy * cdz) + std::abs(bdz * cdy)) +
+        std::abs(bdx) * (std::abs(cdy * adz) + std::abs(cdz * ady)) +
+        std::abs(cdx) * (std::abs(ady * bdz) + std::abs(adz * bdy));
+    auto bound = 7.771561172376103e-16 * permanent;
+
+    if (det > bound)
+        return 1;
+    else if (det < -bound)
+        return -1;
+
+    long double ax = a.x, ay = a.y, az = a.z;
+    long double bx = b.x, by = b.y, bz = b.z;
+    long double cx = c.x, cy = c.y, cz = c.z;
+    long double dx = d.x, dy = d.y, dz = d.z;
+    auto exact = (ax - dx) * ((by - dy) * (cz - dz) - (bz - dz) * (cy - dy)) +
+                 (bx - dx) * ((cy - dy) * (az - dz) - (cz - dz) * (ay - dy)) +
+                 (cx - dx) * ((ay - dy) * (bz - dz) - (az - dz) * (by - dy));
+
+    return (exact > 0) - (exact < 0);
+}
+
+static int orient(double ax, double ay, double bx, double by,
+                  double cx, double cy)
+{
+    auto det = (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+    auto bound = 3.330669073875471e-16 *
+                 (std::abs((bx - ax) * (cy - ay)) +
+                  std::abs((by - ay) * (cx - ax)));
+
+    if (det > bound)
+        return 1;
+    else if (det < -bound)
+        return -1;
+
+    auto exact = ((long double)bx - ax) * ((long double)cy - ay) -
+                 ((long double)by - ay) * ((long double)cx - ax);
+
+    return (exact > 0) - (exact < 0);
+}
+
+// Triangles in a common plane, projected along the axis their normal
+// points to the most.
+static bool overlap(const Vert *t1, const Vert *t2)
+{
+    auto n = cross(t2[0], t2[1], t2[2]);
+    auto nx = std::abs(n.x), ny = std::abs(n.y), nz = std::abs(n.z);
+    double u1[3], v1[3], u2[3], v2[3];
+
+    for (int i = 0; i != 3; i++)
+        if (nx >= ny && nx >= nz)
+            u1[i] = t1[i].y, v1[i] = t1[i].z, u2[i] = t2[i].y, v2[i] = t2[i].z;
+        else if (ny >= nz)
+            u1[i] = t1[i].z, v1[i] = t1[i].x, u2[i] = t2[i].z, v2[i] = t2[i].x;
+        else
+            u1[i] = t1[i].x, v1[i] = t1[i].y, u2[i] = t2[i].x, v2[i] = t2[i].y;
+
+    auto within = [](double a, double b, double c) {
+        return std::min(a, b) <= c && c <= std::max(a, b);
+    };
+
+    for (int i = 0; i != 3; i++)
+        for (int j = 0; j != 3; j++)
+        {
+            auto i2 = (i + 1) % 3, j2 = (j + 1) % 3;
+            auto d1 = orient(u2[j], v2[j], u2[j2], v2[j2], u1[i], v1[i]);
+            auto d2 = orient(u2[j], v2[j], u2[j2], v2[j2], u1[i2], v1[i2]);
+            auto d3 = orient(u1[i], v1[i], u1[i2], v1[i2], u2[j], v2[j]);
+            auto d4 = orient(u1[i], v1[i], u1[i2], v1[i2], u2[j2], v2[j2]);
+
+            if (d1 * d2 < 0 && d3 * d4 < 0)
+                return true;
+
+            if ((d1 == 0 && within(u2[j], u2[j2], u1[i]) &&
+                 within(v2[j], v2[j2], v1[i])) ||
+                (d2 == 0 && within(u2[j], u2[j2], u1[i2]) &&
+                 within(v2[j], v2[j2], v1[i2])) ||
+                (d3 == 0 && within(u1[i], u1[i2], u2[j]) &&
+                 within(v1[i], v1[i2], v2[j])) ||
+                (d4 == 0 && within(u1[i], u1[i2], u2[j2]) &&
+                 within(v1[i], v1[i2], v2[j2])))
+                return true;
+        }
+
+    auto inside = [](const double *u, const double *v, double x, double y) {
+        auto s1 = orient(u[0], v[0], u[1], v[1], x, y);
+        auto s2 = orient(u[1], v[1], u[2], v[2], x, y);
+        auto s3 = orient(u[2], v[2], u[0], v[0], x, y);
+        return (s1 >= 0 && s2 >= 0 && s3 >= 0) ||
+               (s1 <= 0 && s2 <= 0 && s3 <= 0);
+    };
+
+    return inside(u2, v2, u1[0], v1[0]) || inside(u1, v1, u2[0], v2[0]);
+}
+
+// Whether segment a b touches triangle p q r. A segment in the plane of
+// the triangle is handled as a flat triangle.
+static bool pierce(const Vert &a, const Vert &b,
+                   const Vert &p, const Vert &q, const Vert &r)
+{
+    auto sa = orient(p, q, r, a), sb = orient(p, q, r, b);
+
+    if (sa == 0 && sb == 0)
+    {
+        Vert t1[3] = {a, b, b}, t2[3] = {p, q, r};
+        return overlap(t1, t2);
+    }
+
+    if (sa * sb > 0)
+        return false;
+
+    auto s1 = orient(a, b, p, q);
+    auto s2 = orient(a, b, q, r);
+    auto s3 = orient(a, b, r, p);
+
+    return (s1 >= 0 && s2 >= 0 && s3 >= 0) || (s1 <= 0 && s2 <= 0 && s3 <= 0);
+}
+
+static bool collide(const Vert *t1, const Vert *t2)
+{
+    if (orient(t2[0], t2[1], t2[2], t1[0]) == 0 &&
+        orient(t2[0], t2[1], t2[2], t1[1]) == 0 &&
+        orient(t2[0], t2[1], t2[2], t1[2]) == 0)
+        return overlap(t1, t2);
+
+    for (int i = 0; i != 3; i++)
+        if (pierce(t1[i], t1[(i + 1) % 3], t2[0], t2[1], t2[2]) ||
+            pierce(t2[i], t2[(i + 1) % 3], t1[0], t1[1], t1[2]))
+            return true;
+
+    return false;
+}
+
+
+// Eikonal update of c from the known corners a and b of one triangle,
+// with a planar front through both. When the front would arrive from
+// outside the triangle it falls back to the two edges.
+static double update(const Vert &c, const Vert &a, double ta,
+                     const Vert &b, double tb)
+{
+    Vert e1(a.x - c.x, a.y - c.y, a.z - c.z);
+    Vert e2(b.x - c.x, b.y - c.y, b.z - c.z);
+    auto g11 = e1.x * e1.x + e1.y * e1.y + e1.z * e1.z;
+    auto g12 = e1.x * e2.x + e1.y * e2.y + e1.z * e2.z;
+    auto g22 = e2.x * e2.x + e2.y * e2.y + e2.z * e2.z;
+    auto edge = std::min(ta + std::sqrt(g11), tb + std::sqrt(g22));
+    auto det = g11 * g22 - g12 * g12;
+
+    if (!(det > 0))
+        return edge;
+
+    auto q11 = g22 / det, q12 = -g12 / det, q22 = g11 / det;
+    auto s1 = q11 + q12, s2 = q12 + q22;
+    auto a2 = s1 + s2;
+    auto b2 = s1 * ta + s2 * tb;
+    auto c2 = ta * (q11 * ta + q12 * tb) + tb * (q12 * ta + q22 * tb) - 1;
+    auto disc = b2 * b2 - a2 * c2;
+
+    if (disc < 0)
+        return edge;
+
+    auto p = (b2 + std::sqrt(disc)) / a2;
+
+    if (q11 * (ta - p) + q12 * (tb - p) > 0 ||
+        q12 * (ta - p) + q22 * (tb - p) > 0)
+        return edge;
+
+    return std::min(p, edge);
+}
+
+std::vector<std::size_t> Geom::reorder(Verts &verts, Faces &faces,
+                                       Edges &edges)
+{
+    std::vector<std::size_t> map;
+
+    if (verts.size() == 0)
+        return map;
+
+    std::vector<std::size_t> vectorIdx(verts.size());
+    std::vector<Vert> vectorVerts(verts.size());
+    verts.copy_all(&vectorIdx[0], &vectorVerts[0]);
+
+    auto INF = std::numeric_limits<double>::infinity();
+    Vert lower(INF, INF, INF), upper(-INF, -INF, -INF);
+
+    for (std::size_t i = 0; i != vectorVerts.size(); i++)
+    {
+        lower.x = std::min(lower.x, vectorVerts[i].x);
+        lower.y = std::min(lower.y, vectorVerts[i].y);
+        lower.z = std::min(lower.z, vectorVerts[i].z);
+        upper.x = std::max(upper.x, vectorVerts[i].x);
+        upper.y = std::max(upper.y, vectorVerts[i].y);
+        upper.z = std::max(upper.z, vectorVerts[i].z);
+    }
+
+    auto extent = std::max(upper.x - lower.x,
+                           std::max(upper.y - lower.y, upper.z - lower.z));
+    auto scale = extent > 0 ? 0x1fffff / extent : 0;
+    std::vector<std::pair<std::uint64_t, std::size_t>> codes(verts.size());
+
+    parallel_for(codes.size(), 4096, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i != end; i++)
+        {
+            auto x = std::uint64_t((vectorVerts[i].x - lower.x) * scale);
+            auto y = std::uint64_t((vectorVerts[i].y - lower.y) * scale);
+            auto z = std::uint64_t((vectorVerts[i].z - lower.z) * scale);
+            codes[i].first = spread(x) | spread(y) << 1 | spread(z) << 2;
+            codes[i].second = i;
+        }
+    });
+
+    std::sort(codes.begin(), codes.end());
+    map.assign(vectorIdx.back() + 1, -1);
+
+    for (std::size_t i = 0; i != codes.size(); i++)
+        map[vectorIdx[codes[i].second]] = i;
+
+    // Faces stay sorted by their smallest vertex whatever the numbering, so
+    // only the vertex numbering follows the optimized sequence. Numbering
+    // by first use keeps the vertices of nearby faces close together and
+    // brings the sorted order near the sequence, as acmr() shows.
+    std::vector<Face> vectorFaces(faces.size());
+    std::vector<void *> vectorPtr(faces.size());
+    std::size_t count = 0;
+
+    if (!vectorFaces.empty())
+        faces.copy_all(&vectorFaces[0], &vectorPtr[0]);
+
+    for (std::size_t i = 0; i != vectorFaces.size(); i++)
+    {
+        auto face = vectorFaces[i];
+
+        if (face.v1 >= map.size() || face.v2 >= map.size() ||
+            face.v3 >= map.size())
+            continue;
+
+        face = Face(map[face.v1], map[face.v2], map[face.v3]);
+
+        if (face.v1 != std::size_t(-1) && face.v2 != std::size_t(-1) &&
+            face.v3 != std::size_t(-1))
+            vectorFaces[count++] = face;
+    }
+
+    vectorFaces.resize(count);
+
+    if (!vectorFaces.empty())
+        Geom::optimize(&vectorFaces[0], vectorFaces.size(), 16);
+
+    std::vector<std::size_t> used(verts.size(), -1);
+    std::size_t next = 0;
+
+    for (std::size_t i = 0; i != vectorFaces.size(); i++)
+    {
+        if (used[vectorFaces[i].v1] == std::size_t(-1))
+            used[vectorFaces[i].v1] = next++;
+
+        if (used[vectorFaces[i].v2] == std::size_t(-1))
+            used[vectorFaces[i].v2] = next++;
+
+        if (used[vectorFaces[i].v3] == std::size_t(-1))
+            used[vectorFaces[i].v3] = next++;
+    }
+
+    for (std::size_t i = 0; i != used.size(); i++)
+        if (used[i] == std::size_t(-1))
+            used[i] = next++;
+
+    for (std::size_t i = 0; i != map.size(); i++)
+        if (map[i] != std::size_t(-1))
+            map[i] = used[map[i]];
+
+    verts.renumber(map);
+    std::thread thread(&Edges::renumber, &edges, std::cref(map));
+    faces.renumber(map);
+    thread.join();
+    return map;
+}
+
+void Geom::optimize(Face *ptr, std::size_t size, std::size_t cache)
+{
+    std::size_t count = 0;
+
+    for (std::size_t i = 0; i != size; i++)
+        count = std::max(count, std::max(ptr[i].v1,
+                                          std::max(ptr[i].v2, ptr[i].v3)) + 1);
+
+    std::vector<std::size_t> offsets(count + 1, 0);
+    std::vector<std::size_t> adjacency(size * 3);
+
+    for (std::size_t i = 0; i != size; i++)
+    {
+        offsets[ptr[i].v1 + 1]++;
+        offsets[ptr[i].v2 + 1]++;
+        offsets[ptr[i].v3 + 1]++;
+    }
+
+    for (std::size_t i = 0; i != count; i++)
+        offsets[i + 1] += offsets[i];
+
+    std::vector<std::size_t> live(count), stamps(count, 0);
+    std::vector<bool> emitted(size, false);
+
+    for (std::size_t i = 0; i != count; i++)
+        live[i] = offsets[i + 1] - offsets[i];
+
+    std::vector<std::size_t> fill(offsets.begin(), offsets.end() - 1);
+
+    for (std::size_t i = 0; i != size; i++)
+    {
+        adjacency[fill[ptr[i].v1]++] = i;
+        adjacency[fill[ptr[i].v2]++] = i;
+        adjacency[fill[ptr[i].v3]++] = i;
+    }
+
+    // Tipsify: fan around the vertex that is most likely to still be in
+    // the cache, falling back to recent dead ends and then to the input.
+    std::vector<Face> output;
+    std::vector<std::size_t> deadEnds, candidates;
+    output.reserve(size);
+    std::size_t time = cache + 1, cursor = 0, fan = 0;
+
+    while (fan < count && live[fan] == 0)
+        fan++;
+
+    while (fan < count)
+    {
+        candidates.clear();
+
+        for (auto i = offsets[fan]; i != offsets[fan + 1]; i++)
+        {
+            auto idx = adjacency[i];
+
+            if (emitted[idx])
+                continue;
+
+            std::size_t verts[3] = {ptr[idx].v1, ptr[idx].v2, ptr[idx].v3};
+
+            for (int j = 0; j != 3; j++)
+            {
+                deadEnds.push_back(verts[j]);
+                candidates.push_back(verts[j]);
+                live[verts[j]]--;
+
+                if (time - stamps[verts[j]] > cache)
+                    stamps[verts[j]] = time++;
+            }
+
+            emitted[idx] = true;
+            output.push_back(ptr[idx]);
+        }
+
+        std::size_t best = count, priority = 0;
+
+        for (std::size_t i = 0; i != candidates.size(); i++)
+        {
+            auto idx = candidates[i];
+
+            if (live[idx] == 0)
+                continue;
+
+            std::size_t score = 0;
+
+            if (time - stamps[idx] + 2 * live[idx] <= cache)
+                score = time - stamps[idx] + 1;
+
+            if (best == count || score > priority)
+                best = idx, priority = score;
+        }
+
+        while (best == count && !deadEnds.empty())
+        {
+            if (live[deadEnds.back()] != 0)
+                best = deadEnds.back();
+
+            deadEnds.pop_back();
+        }
+
+        while (best == count && cursor < count)
+        {
+            if (live[cursor] != 0)
+                best = cursor;
+
+            cursor++;
+        }
+
+        fan = best;
+    }
+
+    std::copy(output.begin(), output.end(), ptr);
+}
+
+double Geom::acmr(const Face *ptr, std::size_t size, std::size_t cache)
+{
+    if (size == 0)
+        return 0;
+
+    std::size_t count = 0, misses = 0, time = cache + 1;
+
+    for (std::size_t i = 0; i != size; i++)
+        count = std::max(count, std::max(ptr[i].v1,
+                                          std::max(ptr[i].v2, ptr[i].v3)) + 1);
+
+    // A FIFO cache hit is a vertex that entered fewer than cache misses ago.
+    std::vector<std::size_t> stamps(count, 0);
+
+    for (std::size_t i = 0; i != size; i++)
+    {
+        std::size_t verts[3] = {ptr[i].v1, ptr[i].v2, ptr[i].v3};
+
+        for (int j = 0; j != 3; j++)
+            if (time - stamps[verts[j]] > cache)
+            {
+                stamps[verts[j]] = time++;
+                misses++;
+            }
+    }
+
+    return double(misses) / size;
+}
+
+void Geom::bounds(const Verts &verts, Vert &lower, Vert &upper)
+{
+    std::vector<Vert> vector(verts.size());
+
+    if (!vector.empty())
+        verts.copy_all(&vector[0]);
+
+    auto INF = std::numeric_limits<double>::infinity();
+    auto blocks = (vector.size() + BLOCK - 1) / BLOCK;
+    std::vector<Vert> lowers(blocks, Vert(INF, INF, INF));
+    std::vector<Vert> uppers(blocks, Vert(-INF, -INF, -INF));
+
+    parallel_for(blocks, 1, [&](std::size_t begin, std::size_t end) {
+        for (auto block = begin; block != end; block++)
+        {
+            auto first = block * BLOCK;
+            auto last = std::min(first + BLOCK, vector.size());
+            extremes(&vector[first], last - first, lowers[block],
+                     uppers[block]);
+        }
+    });
+
+    lower = Vert(INF, INF, INF), upper = Vert(-INF, -INF, -INF);
+
+    for (std::size_t i = 0; i != blocks; i++)
+    {
+        lower.x = std::min(lower.x, lowers[i].x);
+        lower.y = std::min(lower.y, lowers[i].y);
+        lower.z = std::min(lower.z, lowers[i].z);
+        upper.x = std::max(upper.x, uppers[i].x);
+        upper.y = std::max(upper.y, uppers[i].y);
+        upper.z = std::max(upper.z, uppers[i].z);
+    }
+}
+
+void Geom::measure(const Verts &verts, const Faces &faces,
+                   double &area, double &volume, Vert &centroid)
+{
+    auto vectorVerts = flatten(verts);
+    auto vectorFaces = flatten(faces);
+    auto blocks = (vectorFaces.size() + BLOCK - 1) / BLOCK;
+    std::vector<Sum> areas(blocks), volumes(blocks);
+    std::vector<Sum> xs(blocks), ys(blocks), zs(blocks);
+
+    // Volume and centroid come from the signed tetrahedra spanned by each
+    // face and the origin, which is exact for closed, consistently wound
+    // meshes. Each block writes the terms of its faces to arrays and then
+    // sums every array at once. Faces on missing or non-finite corners
+    // add nothing.
+    parallel_for(blocks, 1, [&](std::size_t begin, std::size_t end) {
+        std::vector<double> terms(5 * BLOCK);
+
+        for (auto block = begin; block != end; block++)
+        {
+            auto first = block * BLOCK;
+            auto last = std::min(first + BLOCK, vectorFaces.size());
+            auto size = last - first;
+            auto termsArea = &terms[0], termsVolume = &terms[BLOCK];
+            auto termsX = &terms[2 * BLOCK], termsY = &terms[3 * BLOCK];
+            auto termsZ = &terms[4 * BLOCK];
+
+            for (std::size_t k = 0; k != size; k++)
+            {
+                auto face = vectorFaces[first + k];
+                termsArea[k] = termsVolume[k] = 0;
+                termsX[k] = termsY[k] = termsZ[k] = 0;
+
+                if (face.v1 >= vectorVerts.size() ||
+                    face.v2 >= vectorVerts.size() ||
+                    face.v3 >= vectorVerts.size() ||
+                    !finite(vectorVerts[face.v1]) ||
+                    !finite(vectorVerts[face.v2]) ||
+                    !finite(vectorVerts[face.v3]))
+                    continue;
+
+                auto a = vectorVerts[face.v1];
+                auto b = vectorVerts[face.v2];
+                auto c = vectorVerts[face.v3];
+                auto nx = (b.y - a.y) * (c.z - a.z) - (b.z - a.z) * (c.y - a.y);
+                auto ny = (b.z - a.z) * (c.x - a.x) - (b.x - a.x) * (c.z - a.z);
+                auto nz = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+                auto det = a.x * (b.y * c.z - b.z * c.y) -
+                           a.y * (b.x * c.z - b.z * c.x) +
+                           a.z * (b.x * c.y - b.y * c.x);
+
+                termsArea[k] = std::sqrt(nx * nx + ny * ny + nz * nz) / 2;
+                termsVolume[k] = det / 6;
+                termsX[k] = det * (a.x + b.x + c.x) / 24;
+                termsY[k] = det * (a.y + b.y + c.y) / 24;
+                termsZ[k] = det * (a.z + b.z + c.z) / 24;
+            }
+
+            areas[block].add(termsArea, size);
+            volumes[block].add(termsVolume, size);
+            xs[block].add(termsX, size);
+            ys[block].add(termsY, size);
+            zs[block].add(termsZ, size);
+        }
+    });
+
+    Sum sumArea, sumVolume, sumX, sumY, sumZ;
+
+    for (std::size_t i = 0; i != blocks; i++)
+    {
+        sumArea.add(areas[i].value());
+        sumVolume.add(volumes[i].value());
+        sumX.add(xs[i].value());
+        sumY.add(ys[i].value());
+        sumZ.add(zs[i].value());
+    }
+
+    area = sumArea.value();
+    volume = sumVolume.value();
+
+    if (volume != 0)
+        centroid = Vert(sumX.value() / volume, sumY.value() / volume,
+                        sumZ.value() / volume);
+    else
+    {
+        auto INF = std::numeric_limits<double>::infinity();
+        centroid = Vert(INF, INF, INF);
+    }
+}
+
+double Geom::area(const Verts &verts, const Faces &faces)
+{
+    double area, volume;
+    Vert centroid;
+    Geom::measure(verts, faces, area, volume, centroid);
+    return area;
+}
+
+double Geom::volume(const Verts &verts, const Faces &faces)
+{
+    double area, volume;
+    Vert centroid;
+    Geom::measure(verts, faces, area, volume, centroid);
+    return volume;
+}
+
+Vert Geom::centroid(const Verts &verts, const Faces &faces)
+{
+    double area, volume;
+    Vert centroid;
+    Geom::measure(verts, faces, area, volume, centroid);
+    return centroid;
+}
+
+std::size_t Geom::simplify(Verts &verts, Faces &faces,
+                           std::size_t target, double bound)
+{
+    std::vector<std::size_t> vectorIdx(verts.size());
+    std::vector<Vert> vectorVerts(verts.size());
+    std::vector<Face> vectorFaces(faces.size());
+    std::vector<void *> vectorPtr(faces.size());
+
+    if (vectorIdx.empty() || vectorFaces.empty())
+        return 0;
+
+    verts.copy_all(&vectorIdx[0], &vectorVerts[0]);
+    faces.copy_all(&vectorFaces[0], &vectorPtr[0]);
+
+    auto count = vectorIdx.back() + 1;
+    auto INF = std::numeric_limits<double>::infinity();
+    std::vector<Vert> positions(count, Vert(INF, INF, INF));
+    std::vector<bool> alive(count, false), aliveFaces(vectorFaces.size());
+    std::vector<bool> moved(count, false), removed(count, false);
+    std::vector<bool> borders(count, false), pinned(count, false);
+    std::vector<bool> foreign(vectorFaces.size(), false);
+    std::vector<std::vector<std::size_t>> incident(count);
+    std::vector<Quadric> quadrics(count);
+    std::vector<std::size_t> changed(count, 0);
+
+    for (std::size_t i = 0; i != vectorIdx.size(); i++)
+    {
+        positions[vectorIdx[i]] = vectorVerts[i];
+        alive[vectorIdx[i]] = true;
+    }
+
+    for (std::size_t i = 0; i != vectorFaces.size(); i++)
+    {
+        auto face = vectorFaces[i];
+        aliveFaces[i] = face.v1 < count && face.v2 < count &&
+                        face.v3 < count && alive[face.v1] &&
+                        alive[face.v2] && alive[face.v3];
+
+        // Faces on a vertex missing from verts are kept as they are, and
+        // their other corners are pinned so they are not collapsed away.
+        if (!aliveFaces[i])
+        {
+            foreign[i] = true;
+
+            for (auto v : {face.v1, face.v2, face.v3})
+                if (v < count)
+                    pinned[v] = true;
+
+            continue;
+        }
+
+        incident[face.v1].push_back(i);
+        incident[face.v2].push_back(i);
+        incident[face.v3].push_back(i);
+
+        auto a = positions[face.v1];
+        auto normal = cross(a, positions[face.v2], positions[face.v3]);
+        auto length = std::sqrt(normal.x * normal.x + normal.y * normal.y +
+                                normal.z * normal.z);
+
+        if (length == 0)
+            continue;
+
+        normal = Vert(normal.x / length, normal.y / length, normal.z / length);
+        Quadric quadric(normal.x, normal.y, normal.z,
+                        -(normal.x * a.x + normal.y * a.y + normal.z * a.z),
+                        length / 2);
+        quadrics[face.v1].add(quadric);
+        quadrics[face.v2].add(quadric);
+        quadrics[face.v3].add(quadric);
+    }
+
+    // The faces shared by the edge (u, v) among the faces around u.
+    auto shared = [&](std::size_t u, std::size_t v) {
+        std::size_t number = 0;
+
+        for (auto f : incident[u])
+            if (aliveFaces[f] && (vectorFaces[f].v1 == v ||
+                                  vectorFaces[f].v2 == v ||
+                                  vectorFaces[f].v3 == v))
+                number++;
+
+        return number;
+    };
+
+    // Boundary edges get a heavily weighted plane perpendicular to their
+    // face, which keeps open borders in place.
+    for (std::size_t i = 0; i != vectorFaces.size(); i++)
+    {
+        if (!aliveFaces[i])
+            continue;
+
+        std::size_t corners[3] = {vectorFaces[i].v1, vectorFaces[i].v2,
+                                  vectorFaces[i].v3};
+        auto normal = cross(positions[corners[0]], positions[corners[1]],
+                            positions[corners[2]]);
+
+        for (int j = 0; j != 3; j++)
+        {
+            auto u = corners[j], v = corners[(j + 1) % 3];
+
+            if (shared(u, v) != 1)
+                continue;
+
+            borders[u] = borders[v] = true;
+            auto a = positions[u], b = positions[v];
+            auto side = Vert(b.x - a.x, b.y - a.y, b.z - a.z);
+            auto plane = Vert(side.y * normal.z - side.z * normal.y,
+                              side.z * normal.x - side.x * normal.z,
+                              side.x * normal.y - side.y * normal.x);
+            auto length = std::sqrt(plane.x * plane.x + plane.y * plane.y +
+                                    plane.z * plane.z);
+
+            if (length == 0)
+                continue;
+
+            plane = Vert(plane.x / length, plane.y / length, plane.z / length);
+            Quadric quadric(plane.x, plane.y, plane.z,
+                            -(plane.x * a.x + plane.y * a.y + plane.z * a.z),
+                            1000 * (side.x * side.x + side.y * side.y +
+                                    side.z * side.z));
+            quadrics[u].add(quadric);
+            quadrics[v].add(quadric);
+        }
+    }
+
+    // Heap entries only keep the cost and when they were made, the target
+    // is solved again once an entry is popped and still current.
+    std::priority_queue<Collapse> heap;
+    std::size_t collapses = 0;
+
+    auto solve = [&](std::size_t u, std::size_t v, Vert &target) {
+        auto quadric = quadrics[u];
+        quadric.add(quadrics[v]);
+
+        if (!quadric.optimum(target))
+        {
+            auto a = positions[u], b = positions[v];
+            Vert mid((a.x + b.x) / 2, (a.y + b.y) / 2, (a.z + b.z) / 2);
+            target = a;
+
+            if (quadric.error(b) < quadric.error(target))
+                target = b;
+
+            if (quadric.error(mid) < quadric.error(target))
+                target = mid;
+        }
+
+        return quadric.error(target);
+    };
+
+    auto push = [&](std::size_t u, std::size_t v) {
+        Collapse collapse;
+        Vert target;
+        collapse.cost = solve(u, v, target);
+        collapse.u = u, collapse.v = v;
+        collapse.time = collapses;
+        heap.push(collapse);
+    };
+
+    for (std::size_t i = 0; i != vectorFaces.size(); i++)
+        if (aliveFaces[i])
+        {
+            auto face = vectorFaces[i];
+
+            if (face.v1 < face.v2 || shared(face.v1, face.v2) == 1)
+                push(face.v1, face.v2);
+
+            if (face.v2 < face.v3 || shared(face.v2, face.v3) == 1)
+                push(face.v2, face.v3);
+
+            if (face.v3 < face.v1 || shared(face.v3, face.v1) == 1)
+                push(face.v3, face.v1);
+        }
+
+    auto remaining = vectorFaces.size();
+
+    for (std::size_t i = 0; i != aliveFaces.size(); i++)
+        if (!aliveFaces[i])
+            remaining--;
+
+    std::vector<std::size_t> ringU, ringV;
+
+    auto ring = [&](std::size_t u, std::vector<std::size_t> &ring) {
+        ring.clear();
+
+        for (auto f : incident[u])
+            if (aliveFaces[f])
+            {
+                ring.push_back(vectorFaces[f].v1);
+                ring.push_back(vectorFaces[f].v2);
+                ring.push_back(vectorFaces[f].v3);
+            }
+
+        std::sort(ring.begin(), ring.end());
+        ring.erase(std::unique(ring.begin(), ring.end()), ring.end());
+    };
+
+    // A collapse may not flip or degenerate any face that survives it.
+    auto flips = [&](std::size_t u, std::size_t v, const Vert &target) {
+        for (auto f : incident[u])
+        {
+            auto face = vectorFaces[f];
+
+            if (!aliveFaces[f] || face.v1 == v || face.v2 == v ||
+                face.v3 == v)
+                continue;
+
+            auto before = cross(positions[face.v1], positions[face.v2],
+                                positions[face.v3]);
+            auto a = face.v1 == u ? target : positions[face.v1];
+            auto b = face.v2 == u ? target : positions[face.v2];
+            auto c = face.v3 == u ? target : positions[face.v3];
+            auto after = cross(a, b, c);
+            auto dot = before.x * after.x + before.y * after.y +
+                       before.z * after.z;
+            auto norm = std::sqrt(before.x * before.x + before.y * before.y +
+                                  before.z * before.z) *
+                        std::sqrt(after.x * after.x + after.y * after.y +
+                                  after.z * after.z);
+
+            if (dot <= 0.2 * norm)
+                return true;
+        }
+
+        return false;
+    };
+
+    while (remaining > target && !heap.empty())
+    {
+        auto collapse = heap.top();
+        heap.pop();
+        auto u = collapse.u, v = collapse.v;
+
+        if (!alive[u] || !alive[v] || changed[u] > collapse.time ||
+            changed[v] > collapse.time)
+            continue;
+
+        if (collapse.cost > bound)
+            break;
+
+        Vert target;
+        solve(u, v, target);
+
+        // Link condition: the common neighbors of u and v must be exactly
+        // the apexes of the faces on the edge.
+        auto faceCount = shared(u, v);
+        ringU.clear(), ringV.clear();
+        ring(u, ringU);
+        ring(v, ringV);
+        std::size_t common = 0;
+
+        for (std::size_t i = 0, j = 0; i != ringU.size() && j != ringV.size();)
+            if (ringU[i] < ringV[j])
+                i++;
+            else if (ringV[j] < ringU[i])
+                j++;
+            else
+            {
+                if (ringU[i] != u && ringU[i] != v)
+                    common++;
+
+                i++, j++;
+            }
+
+        if (faceCount == 0 || common != faceCount || pinned[u] ||
+            pinned[v] || (faceCount == 2 && borders[u] && borders[v]) ||
+            flips(u, v, target) || flips(v, u, target))
+            continue;
+
+        for (auto f : incident[v])
+        {
+            if (!aliveFaces[f])
+                continue;
+
+            auto &face = vectorFaces[f];
+
+            if (face.v1 == u || face.v2 == u || face.v3 == u)
+            {
+                aliveFaces[f] = false;
+                remaining--;
+                continue;
+            }
+
+            if (face.v1 == v)
+                face.v1 = u;
+            else if (face.v2 == v)
+                face.v2 = u;
+            else
+                face.v3 = u;
+
+            incident[u].push_back(f);
+        }
+
+        std::size_t size = 0;
+
+        for (auto f : incident[u])
+            if (aliveFaces[f])
+                incident[u][size++] = f;
+
+        incident[u].resize(size);
+        std::vector<std::size_t>().swap(incident[v]);
+
+        positions[u] = target;
+        quadrics[u].add(quadrics[v]);
+        borders[u] = borders[u] || borders[v];
+        alive[v] = false, removed[v] = true, moved[u] = true;
+        changed[u] = ++collapses;
+
+        ring(u, ringU);
+
+        for (auto w : ringU)
+            if (w != u)
+                push(u, w);
+    }
+
+    // Written back in bulk with the indexes deferred, so each of them is
+    // rebuilt once in a sorted pass instead of per vertex and face.
+    std::vector<std::size_t> modifiedIdx;
+    std::vector<Vert> modifiedVerts;
+
+    for (std::size_t i = 0; i != count; i++)
+        if (moved[i] && !removed[i])
+        {
+            modifiedIdx.push_back(i);
+            modifiedVerts.push_back(positions[i]);
+        }
+
+    auto deferredVerts = verts.defer(), deferredFaces = faces.defer();
+    verts.defer(true);
+
+    if (!modifiedIdx.empty())
+        verts.modify(&modifiedIdx[0], &modifiedVerts[0], modifiedIdx.size());
+
+    for (std::size_t i = 0; i != count; i++)
+        if (removed[i])
+            verts.erase(i);
+
+    verts.defer(deferredVerts);
+    faces.clear();
+    faces.defer(true);
+
+    for (std::size_t i = 0; i != vectorFaces.size(); i++)
+        if (aliveFaces[i] || foreign[i])
+            faces.insert(vectorFaces[i], vectorPtr[i]);
+
+    faces.defer(deferredFaces);
+    return collapses;
+}
+
+std::size_t Geom::simplify(Verts &verts, Faces &faces, Edges &edges,
+                           std::size_t target, double bound)
+{
+    auto collapses = Geom::simplify(verts, faces, target, bound);
+    faces.sync(edges);
+    return collapses;
+}
+
+// Splits every face into 4 at its edge midpoints, on flat arrays where a
+// vertex index is its position. The new vertex of the n-th edge in sorted
+// order gets index base + n, base being the number of positions, so the
+// numbering only depends on the input mesh. Faces with a corner out of
+// range are dropped, the 4 faces from face i are 4 * i to 4 * i + 3 of
+// the rest.
+static void split(std::vector<Vert> &positions, std::vector<Face> &vectorFaces,
+                  bool smooth, const Vert &center)
+{
+    auto base = positions.size();
+    std::size_t size = 0;
+
+    for (std::size_t i = 0; i != vectorFaces.size(); i++)
+        if (vectorFaces[i].v1 < base && vectorFaces[i].v2 < base &&
+            vectorFaces[i].v3 < base)
+            vectorFaces[size++] = vectorFaces[i];
+
+    vectorFaces.resize(size);
+    std::vector<Edge> edges(size * 3);
+
+    parallel_for(size, 4096, [&](std::size_t begin, std::size_t end) {
+        for (auto i = begin; i != end; i++)
+        {
+            auto face = vectorFaces[i];
+            edges[3 * i] = Edge(std::min(face.v1, face.v2),
+                                std::max(face.v1, face.v2));
+            edges[3 * i + 1] = Edge(std::min(face.v2, face.v3),
+                                    std::max(face.v2, face.v3));
+            edges[3 * i + 2] = Edge(std::min(face.v3, face.v1),
+                                    std::max(face.v3, face.v1));
+        }
+    });
+
+    std::sort(edges.begin(), edges.end());
+    edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+    auto rank = [&](std::size_t a, std::size_t b) {
+        auto edge = Edge(std::min(a, b), std::max(a, b));
+        return std::size_t(std::lower_bound(edges.begin(), edges.end(),
+                                            edge) -
+                           edges.begin());
+    };
+
+    // Midpoint ranks of edges (v1, v2), (v2, v3), (v3, v1) of each face.
+    std::vector<std::size_t> mids(size * 3);
+
+    parallel_for(size, 4096, [&](std::size_t begin, std::size_t end) {
+        for (auto i = begin; i != end; i++)
+        {
+            mids[3 * i] = rank(vectorFaces[i].v1, vectorFaces[i].v2);
+            mids[3 * i + 1] = rank(vectorFaces[i].v2, vectorFaces[i].v3);
+            mids[3 * i + 2] = rank(vectorFaces[i].v3, vectorFaces[i].v1);
+        }
+    });
+
+    std::vector<Vert> points(edges.size());
+    std::vector<Vert> moved;
+
+    if (!smooth)
+        parallel_for(edges.size(), 4096, [&](std::size_t begin,
+                                             std::size_t end) {
+            for (auto i = begin; i != end; i++)
+            {
+                auto a = positions[edges[i].v1], b = positions[edges[i].v2];
+                auto mid = Vert((a.x + b.x) / 2 - center.x,
+                                (a.y + b.y) / 2 - center.y,
+                                (a.z + b.z) / 2 - center.z);
+                auto ra = std::sqrt((a.x - center.x) * (a.x - center.x) +
+                                    (a.y - center.y) * (a.y - center.y) +
+                                    (a.z - center.z) * (a.z - center.z));
+                auto rb = std::sqrt((b.x - center.x) * (b.x - center.x) +
+                                    (b.y - center.y) * (b.y - center.y) +
+                                    (b.z - center.z) * (b.z - center.z));
+                auto length = std::sqrt(mid.x * mid.x + mid.y * mid.y +
+                                        mid.z * mid.z);
+                auto scale = length > 0 ? (ra + rb) / 2 / length : 0;
+                points[i] = Vert(center.x + mid.x * scale,
+                                 center.y + mid.y * scale,
+                                 center.z + mid.z * scale);
+            }
+        });
+    else
+    {
+        // Loop weights: an interior edge point is 3/8 of its ends plus 1/8
+        // of the two opposite corners, a boundary one is the midpoint.
+        std::vector<Vert> opposite(edges.size(), Vert(0, 0, 0));
+        std::vector<unsigned char> counts(edges.size(), 0);
+
+        for (std::size_t i = 0; i != size; i++)
+        {
+            std::size_t corners[3] = {vectorFaces[i].v3, vectorFaces[i].v1,
+                                      vectorFaces[i].v2};
+
+            for (int j = 0; j != 3; j++)
+            {
+                auto c = positions[corners[j]];
+                auto &sum = opposite[mids[3 * i + j]];
+                sum.x += c.x, sum.y += c.y, sum.z += c.z;
+                counts[mids[3 * i + j]]++;
+            }
+        }
+
+        std::vector<Vert> rings(base, Vert(0, 0, 0));
+        std::vector<Vert> borders(base, Vert(0, 0, 0));
+        std::vector<std::size_t> valences(base, 0), borderCounts(base, 0);
+
+        for (std::size_t i = 0; i != edges.size(); i++)
+        {
+            auto a = positions[edges[i].v1], b = positions[edges[i].v2];
+            auto &ringA = rings[edges[i].v1], &ringB = rings[edges[i].v2];
+            ringA.x += b.x, ringA.y += b.y, ringA.z += b.z;
+            ringB.x += a.x, ringB.y += a.y, ringB.z += a.z;
+            valences[edges[i].v1]++, valences[edges[i].v2]++;
+
+            if (counts[i] == 1)
+            {
+                auto &borderA = borders[edges[i].v1];
+                auto &borderB = borders[edges[i].v2];
+                borderA.x += b.x, borderA.y += b.y, borderA.z += b.z;
+                borderB.x += a.x, borderB.y += a.y, borderB.z += a.z;
+                borderCounts[edges[i].v1]++, borderCounts[edges[i].v2]++;
+            }
+        }
+
+        parallel_for(edges.size(), 4096, [&](std::size_t begin,
+                                             std::size_t end) {
+            for (auto i = begin; i != end; i++)
+            {
+                auto a = positions[edges[i].v1], b = positions[edges[i].v2];
+
+                if (counts[i] == 2)
+                    points[i] = Vert(
+                        (3 * (a.x + b.x) + opposite[i].x) / 8,
+                        (3 * (a.y + b.y) + opposite[i].y) / 8,
+                        (3 * (a.z + b.z) + opposite[i].z) / 8);
+                else
+                    points[i] = Vert((a.x + b.x) / 2, (a.y + b.y) / 2,
+                                     (a.z + b.z) / 2);
+            }
+        });
+
+        moved.resize(base);
+
+        parallel_for(base, 4096, [&](std::size_t begin, std::size_t end) {
+            for (auto i = begin; i != end; i++)
+            {
+                auto v = positions[i];
+                auto n = valences[i];
+
+                if (borderCounts[i] == 2)
+                    moved[i] = Vert(0.75 * v.x + borders[i].x / 8,
+                                    0.75 * v.y + borders[i].y / 8,
+                                    0.75 * v.z + borders[i].z / 8);
+                else if (borderCounts[i] != 0 || n < 3)
+                    moved[i] = v;
+                else
+                {
+                    auto t = 0.375 + 0.25 * std::cos(2 * PI / n);
+                    auto beta = (0.625 - t * t) / n;
+                    moved[i] = Vert((1 - n * beta) * v.x + beta * rings[i].x,
+                                    (1 - n * beta) * v.y + beta * rings[i].y,
+                                    (1 - n * beta) * v.z + beta * rings[i].z);
+                }
+            }
+        });
+    }
+
+    if (smooth)
+        positions.swap(moved);
+
+    positions.insert(positions.end(), points.begin(), points.end());
+    std::vector<Face> split(size * 4);
+
+    parallel_for(size, 4096, [&](std::size_t begin, std::size_t end) {
+        for (auto i = begin; i != end; i++)
+        {
+            auto face = vectorFaces[i];
+            auto ab = base + mids[3 * i], bc = base + mids[3 * i + 1];
+            auto ca = base + mids[3 * i + 2];
+            split[4 * i] = Face(face.v1, ab, ca);
+            split[4 * i + 1] = Face(ab, face.v2, bc);
+            split[4 * i + 2] = Face(ca, bc, face.v3);
+            split[4 * i + 3] = Face(ab, bc, ca);
+        }
+    });
+
+    vectorFaces.swap(split);
+}
+
+// Runs the flat split on a copy of the mesh and writes it back with the
+// indexes deferred, so each of them is rebuilt once in a sorted pass.
+static void split(Verts &verts, Faces &faces, bool smooth, const Vert &center)
+{
+    std::vector<std::size_t> vectorIdx(verts.size());
+    std::vector<Vert> vectorVerts(verts.size());
+    std::vector<Face> vectorFaces(faces.size());
+    std::vector<void *> vectorPtr(faces.size());
+
+    if (vectorIdx.empty() || vectorFaces.empty())
+        return;
+
+    verts.copy_all(&vectorIdx[0], &vectorVerts[0]);
+    faces.copy_all(&vectorFaces[0], &vectorPtr[0]);
+
+    auto base = vectorIdx.back() + 1;
+    auto INF = std::numeric_limits<double>::infinity();
+    std::vector<Vert> positions(base, Vert(INF, INF, INF));
+    std::vector<bool> alive(base, false);
+
+    for (std::size_t i = 0; i != vectorIdx.size(); i++)
+    {
+        positions[vectorIdx[i]] = vectorVerts[i];
+        alive[vectorIdx[i]] = true;
+    }
+
+    std::size_t size = 0;
+
+    for (std::size_t i = 0; i != vectorFaces.size(); i++)
+        if (vectorFaces[i].v1 < base && vectorFaces[i].v2 < base &&
+            vectorFaces[i].v3 < base && alive[vectorFaces[i].v1] &&
+            alive[vectorFaces[i].v2] && alive[vectorFaces[i].v3])
+        {
+            vectorFaces[size] = vectorFaces[i];
+            vectorPtr[size++] = vectorPtr[i];
+        }
+
+    vectorFaces.resize(size);
+    vectorPtr.resize(size);
+    split(positions, vectorFaces, smooth, center);
+
+    auto deferredVerts = verts.defer(), deferredFaces = faces.defer();
+    verts.defer(true);
+
+    if (smooth)
+    {
+        for (std::size_t i = 0; i != vectorIdx.size(); i++)
+            vectorVerts[i] = positions[vectorIdx[i]];
+
+        verts.modify(&vectorIdx[0], &vectorVerts[0], vectorIdx.size());
+    }
+
+    for (auto i = base; i != positions.size(); i++)
+        verts.insert(positions[i]);
+
+    verts.defer(deferredVerts);
+    faces.clear();
+    faces.defer(true);
+
+    for (std::size_t i = 0; i != vectorFaces.size(); i++)
+        faces.insert(vectorFaces[i], vectorPtr[i / 4]);
+
+    faces.defer(deferredFaces);
+}
+
+void Geom::subdivide(Verts &verts, Faces &faces, const Vert &center)
+{
+    split(verts, faces, false, center);
+}
+
+void Geom::loop(Verts &verts, Faces &faces)
+{
+    split(verts, faces, true, Vert(0, 0, 0));
+}
+
+void Geom::subdivide(std::vector<Vert> &verts, std::vector<Face> &faces,
+                     const Vert &center)
+{
+    split(verts, faces, false, center);
+}
+
+void Geom::loop(std::vector<Vert> &verts, std::vector<Face> &faces)
+{
+    split(verts, faces, true, Vert(0, 0, 0));
+}
+
+void Geom::smooth(Verts &verts, const Faces &faces, std::size_t iterations,
+                  double lambda, double mu)
+{
+    Geom::smooth(verts, faces, iterations, lambda, mu,
+                 std::vector<double>());
+}
+
+void Geom::smooth(Verts &verts, const Faces &faces, std::size_t iterations,
+                  double lambda, double mu, const std::vector<double> &weights)
+{
+    std::vector<std::size_t> vectorIdx(verts.size());
+    std::vector<Vert> vectorVerts(verts.size());
+
+    if (vectorIdx.empty())
+        return;
+
+    verts.copy_all(&vectorIdx[0], &vectorVerts[0]);
+
+    auto count = vectorIdx.back() + 1;
+    auto INF = std::numeric_limits<double>::infinity();
+    std::vector<Vert> current(count, Vert(INF, INF, INF)), next(count);
+    std::vector<bool> alive(count, false);
+
+    for (std::size_t i = 0; i != vectorIdx.size(); i++)
+    {
+        current[vectorIdx[i]] = vectorVerts[i];
+        alive[vectorIdx[i]] = true;
+    }
+
+    auto vectorFaces = flatten(faces);
+    std::size_t size = 0;
+
+    for (std::size_t i = 0; i != vectorFaces.size(); i++)
+    {
+        auto face = vectorFaces[i];
+
+        if (face.v1 < count && face.v2 < count && face.v3 < count &&
+            alive[face.v1] && alive[face.v2] && alive[face.v3])
+            vectorFaces[size++] = face;
+    }
+
+    vectorFaces.resize(size);
+    std::vector<std::size_t> offsets, neighbors;
+    adjacency(vectorFaces, count, offsets, neighbors);
+
+    // Each step reads only the current buffer and writes only the next,
+    // so vertices are independent. A non-zero mu adds Taubin's inflating
+    // step after every shrinking one.
+    auto step = [&](double factor) {
+        parallel_for(count, 4096, [&](std::size_t begin, std::size_t end) {
+            for (auto v = begin; v != end; v++)
+            {
+                auto first = offsets[v], last = offsets[v + 1];
+                auto weight = v < weights.size() ? weights[v] : 1.0;
+                next[v] = current[v];
+
+                if (first == last || weight == 0)
+                    continue;
+
+                Vert sum(0, 0, 0);
+
+                for (auto i = first; i != last; i++)
+                {
+                    sum.x += current[neighbors[i]].x;
+                    sum.y += current[neighbors[i]].y;
+                    sum.z += current[neighbors[i]].z;
+                }
+
+                auto scale = weight * factor;
+                auto n = double(last - first);
+                next[v].x += scale * (sum.x / n - current[v].x);
+                next[v].y += scale * (sum.y / n - current[v].y);
+                next[v].z += scale * (sum.z / n - current[v].z);
+            }
+        });
+
+        current.swap(next);
+    };
+
+    for (std::size_t i = 0; i != iterations; i++)
+    {
+        step(lambda);
+
+        if (mu != 0)
+            step(mu);
+    }
+
+    for (std::size_t i = 0; i != vectorIdx.size(); i++)
+        vectorVerts[i] = current[vectorIdx[i]];
+
+    verts.modify(&vectorIdx[0], &vectorVerts[0], vectorIdx.size());
+}
+
+std::vector<std::pair<Face, Face>> Geom::intersect(const Verts &verts,
+                                                   const Faces &faces)
+{
+    std::vector<std::pair<Face, Face>> pairs;
+    auto vectorVerts = flatten(verts);
+    auto vectorFaces = flatten(faces);
+    std::size_t size = 0;
+
+    for (std::size_t i = 0; i != vectorFaces.size(); i++)
+    {
+        auto face = vectorFaces[i];
+
+        if (face.v1 < vectorVerts.size() && face.v2 < vectorVerts.size() &&
+            face.v3 < vectorVerts.size() &&
+            std::isfinite(vectorVerts[face.v1].x) &&
+            std::isfinite(vectorVerts[face.v2].x) &&
+            std::isfinite(vectorVerts[face.v3].x))
+            vectorFaces[size++] = face;
+    }
+
+    vectorFaces.resize(size);
+
+    if (size < 2)
+        return pairs;
+
+    // The grid cell is as large as an average triangle, so most triangles
+    // land in a handful of cells.
+    auto INF = std::numeric_limits<double>::infinity();
+    std::vector<Vert> lowers(size), uppers(size);
+    Vert low(INF, INF, INF);
+    double extent = 0;
+
+    for (std::size_t i = 0; i != size; i++)
+    {
+        auto a = vectorVerts[vectorFaces[i].v1];
+        auto b = vectorVerts[vectorFaces[i].v2];
+        auto c = vectorVerts[vectorFaces[i].v3];
+        lowers[i] = Vert(std::min(a.x, std::min(b.x, c.x)),
+                         std::min(a.y, std::min(b.y, c.y)),
+                         std::min(a.z, std::min(b.z, c.z)));
+        uppers[i] = Vert(std::max(a.x, std::max(b.x, c.x)),
+                         std::max(a.y, std::max(b.y, c.y)),
+                         std::max(a.z, std::max(b.z, c.z)));
+        low.x = std::min(low.x, lowers[i].x);
+        low.y = std::min(low.y, lowers[i].y);
+        low.z = std::min(low.z, lowers[i].z);
+        extent += std::max(uppers[i].x - lowers[i].x,
+                           std::max(uppers[i].y - lowers[i].y,
+                                    uppers[i].z - lowers[i].z));
+    }
+
+    auto cell = extent / size;
+
+    if (!(cell > 0))
+        cell = 1;
+
+    auto key = [&](const Vert &vert, std::uint64_t *ptr) {
+        ptr[0] = std::uint64_t((vert.x - low.x) / cell);
+        ptr[1] = std::uint64_t((vert.y - low.y) / cell);
+        ptr[2] = std::uint64_t((vert.z - low.z) / cell);
+    };
+
+    // Every triangle is binned into all cells its box overlaps, counted
+    // first so both passes can run in parallel. A triangle whose box would
+    // cover more than CELLS cells is kept out of the grid and tested
+    // against all others instead.
+    const std::uint64_t CELLS = 64;
+    std::vector<std::size_t> offsets(size + 1, 0);
+    std::vector<char> large(size, 0);
+
+    parallel_for(size, 4096, [&](std::size_t begin, std::size_t end) {
+        for (auto i = begin; i != end; i++)
+        {
+            std::uint64_t lo[3], up[3];
+            key(lowers[i], lo), key(uppers[i], up);
+            auto x = up[0] - lo[0] + 1, y = up[1] - lo[1] + 1,
+                 z = up[2] - lo[2] + 1;
+
+            if (x > CELLS || y > CELLS || z > CELLS || x * y * z > CELLS)
+                large[i] = 1;
+            else
+                offsets[i + 1] = x * y * z;
+        }
+    });
+
+    std::vector<std::size_t> larges;
+
+    for (std::size_t i = 0; i != size; i++)
+    {
+        offsets[i + 1] += offsets[i];
+
+        if (large[i])
+            larges.push_back(i);
+    }
+
+    std::vector<std::pair<std::uint64_t, std::size_t>> cells(offsets[size]);
+
+    parallel_for(size, 4096, [&](std::size_t begin, std::size_t end) {
+        for (auto i = begin; i != end; i++)
+        {
+            if (large[i])
+                continue;
+
+            std::uint64_t lo[3], up[3];
+            key(lowers[i], lo), key(uppers[i], up);
+            auto next = offsets[i];
+
+            for (auto x = lo[0]; x <= up[0]; x++)
+                for (auto y = lo[1]; y <= up[1]; y++)
+                    for (auto z = lo[2]; z <= up[2]; z++)
+                        cells[next++] = std::pair<std::uint64_t, std::size_t>(
+                            spread(x) | spread(y) << 1 | spread(z) << 2, i);
+        }
+    });
+
+    std::sort(cells.begin(), cells.end());
+
+    std::vector<std::size_t> runs;
+
+    for (std::size_t i = 0; i != cells.size(); i++)
+        if (i == 0 || cells[i].first != cells[i - 1].first)
+            runs.push_back(i);
+
+    runs.push_back(cells.size());
+
+    auto test = [&](std::size_t f1, std::size_t f2,
+                    std::vector<std::pair<Face, Face>> &found) {
+        auto face1 = vectorFaces[f1], face2 = vectorFaces[f2];
+        std::size_t corners1[3] = {face1.v1, face1.v2, face1.v3};
+        std::size_t corners2[3] = {face2.v1, face2.v2, face2.v3};
+        auto shared = false;
+
+        for (int k = 0; k != 9 && !shared; k++)
+            shared = corners1[k / 3] == corners2[k % 3];
+
+        if (shared)
+            return;
+
+        Vert t1[3] = {vectorVerts[face1.v1], vectorVerts[face1.v2],
+                      vectorVerts[face1.v3]};
+        Vert t2[3] = {vectorVerts[face2.v1], vectorVerts[face2.v2],
+                      vectorVerts[face2.v3]};
+
+        if (collide(t1, t2))
+            found.push_back(face1 < face2
+                                ? std::pair<Face, Face>(face1, face2)
+                                : std::pair<Face, Face>(face2, face1));
+    };
+
+    auto apart = [&](std::size_t f1, std::size_t f2) {
+        auto &a = lowers[f1], &b = lowers[f2];
+        auto &c = uppers[f1], &d = uppers[f2];
+        return c.x < b.x || d.x < a.x || c.y < b.y || d.y < a.y ||
+               c.z < b.z || d.z < a.z;
+    };
+
+    // A pair is tested only in the cell holding the low corner of the
+    // overlap of its boxes, so no pair is reported twice.
+    auto blocks = (runs.size() - 1 + BLOCK - 1) / BLOCK;
+    std::vector<std::vector<std::pair<Face, Face>>> found(
+        blocks + larges.size());
+
+    parallel_for(blocks, 1, [&](std::size_t begin, std::size_t end) {
+        for (auto block = begin; block != end; block++)
+        {
+            auto first = block * BLOCK;
+            auto last = std::min(first + BLOCK, runs.size() - 1);
+
+            for (auto run = first; run != last; run++)
+                for (auto i = runs[run]; i != runs[run + 1]; i++)
+                    for (auto j = i + 1; j != runs[run + 1]; j++)
+                    {
+                        auto f1 = cells[i].second, f2 = cells[j].second;
+
+                        if (apart(f1, f2))
+                            continue;
+
+                        auto &a = lowers[f1], &b = lowers[f2];
+                        std::uint64_t corner[3];
+                        key(Vert(std::max(a.x, b.x), std::max(a.y, b.y),
+                                 std::max(a.z, b.z)),
+                            corner);
+
+                        if ((spread(corner[0]) | spread(corner[1]) << 1 |
+                             spread(corner[2]) << 2) == cells[i].first)
+                            test(f1, f2, found[block]);
+                    }
+        }
+    });
+
+    // Large triangles meet every triangle after them once, and every
+    // binned one.
+    parallel_for(larges.size(), 1, [&](std::size_t begin, std::size_t end) {
+        for (auto k = begin; k != end; k++)
+        {
+            auto f1 = larges[k];
+
+            for (std::size_t f2 = 0; f2 != size; f2++)
+                if (f2 != f1 && (!large[f2] || f2 > f1) && !apart(f1, f2))
+                    test(f1, f2, found[blocks + k]);
+        }
+    });
+
+    for (std::size_t i = 0; i != found.size(); i++)
+        pairs.insert(pairs.end(), found[i].begin(), found[i].end());
+
+    std::sort(pairs.begin(), pairs.end(),
+              [](const std::pair<Face, Face> &pair1,
+                 const std::pair<Face, Face> &pair2) {
+                  return pair1.first < pair2.first ||
+                         (pair1.first == pair2.first &&
+                          pair1.second < pair2.second);
+              });
+
+    // Cells far apart can share a key once the grid outgrows 21 bits per
+    // axis, which only repeats a pair.
+    pairs.erase(std::unique(pairs.begin(), pairs.end(),
+                            [](const std::pair<Face, Face> &pair1,
+                               const std::pair<Face, Face> &pair2) {
+                                return pair1.first == pair2.first &&
+                                       pair1.second == pair2.second;
+                            }),
+                pairs.end());
+    return pairs;
+}
+
+std::vector<double> Geom::geodesic(const Verts &verts, const Faces &faces,
+                                   const std::vector<std::size_t> &seeds,
+                                   bool march)
+{
+    return Geom::geodesic(verts, faces,
+                          std::vector<std::vector<std::size_t>>(1, seeds),
+                          march)[0];
+}
+
+std::vector<std::vector<double>> Geom::geodesic(
+    const Verts &verts, const Faces &faces,
+    const std::vector<std::vector<std::size_t>> &sources, bool march)
+{
+    auto vectorVerts = flatten(verts);
+    auto vectorFaces = flatten(faces);
+    auto count = vectorVerts.size();
+    std::size_t size = 0;
+
+    for (std::size_t i = 0; i != vectorFaces.size(); i++)
+    {
+        auto face = vectorFaces[i];
+
+        if (face.v1 < count && face.v2 < count && face.v3 < count &&
+            std::isfinite(vectorVerts[face.v1].x) &&
+            std::isfinite(vectorVerts[face.v2].x) &&
+            std::isfinite(vectorVerts[face.v3].x))
+            vectorFaces[size++] = face;
+    }
+
+    vectorFaces.resize(size);
+
+    // Dijkstra walks the vertex rows, fast marching the faces around each
+    // vertex. Both are shared read-only by every source set.
+    std::vector<std::size_t> offsets, neighbors;
+    std::vector<std::size_t> offsetsFaces(count + 1, 0), incident;
+
+    if (!march)
+        adjacency(vectorFaces, count, offsets, neighbors);
+    else
+    {
+        for (std::size_t i = 0; i != size; i++)
+        {
+            offsetsFaces[vectorFaces[i].v1 + 1]++;
+            offsetsFaces[vectorFaces[i].v2 + 1]++;
+            offsetsFaces[vectorFaces[i].v3 + 1]++;
+        }
+
+        for (std::size_t i = 0; i != count; i++)
+            offsetsFaces[i + 1] += offsetsFaces[i];
+
+        incident.resize(offsetsFaces[count]);
+        std::vector<std::size_t> fill(offsetsFaces.begin(),
+                                      offsetsFaces.end() - 1);
+
+        for (std::size_t i = 0; i != size; i++)
+        {
+            incident[fill[vectorFaces[i].v1]++] = i;
+            incident[fill[vectorFaces[i].v2]++] = i;
+            incident[fill[vectorFaces[i].v3]++] = i;
+        }
+    }
+
+    auto length = [&vectorVerts](std::size_t u, std::size_t v) {
+        auto &a = vectorVerts[u], &b = vectorVerts[v];
+        return std::sqrt((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y) +
+                         (a.z - b.z) * (a.z - b.z));
+    };
+
+    auto INF = std::numeric_limits<double>::infinity();
+    std::vector<std::vector<double>> fields(sources.size());
+
+    parallel_for(sources.size(), 1, [&](std::size_t begin, std::size_t end) {
+        for (auto i = begin; i != end; i++)
+        {
+            auto &dist = fields[i];
+            dist.assign(count, INF);
+            std::vector<bool> known(count, false);
+            RadixHeap heap;
+
+            for (std::size_t j = 0; j != sources[i].size(); j++)
+            {
+                auto seed = sources[i][j];
+
+                if (seed < count && std::isfinite(vectorVerts[seed].x))
+                {
+                    dist[seed] = 0;
+                    heap.push(0, seed);
+                }
+            }
+
+            while (!heap.empty())
+            {
+                auto v = heap.pop().second;
+
+                if (known[v])
+                    continue;
+
+                known[v] = true;
+
+                if (!march)
+                {
+                    for (auto k = offsets[v]; k != offsets[v + 1]; k++)
+                    {
+                        auto u = neighbors[k];
+                        auto next = dist[v] + length(u, v);
+
+                        if (next < dist[u])
+                        {
+                            dist[u] = next;
+                            heap.push(next, u);
+                        }
+                    }
+
+                    continue;
+                }
+
+                for (auto k = offsetsFaces[v]; k != offsetsFaces[v + 1]; k++)
+                {
+                    auto face = vectorFaces[incident[k]];
+                    std::size_t corners[3] = {face.v1, face.v2, face.v3};
+
+                    for (std::size_t c = 0; c != 3; c++)
+                    {
+                        auto u = corners[c];
+
+                        if (u == v || known[u])
+                            continue;
+
+                        auto w = corners[0] + corners[1] + corners[2] - u - v;
+                        auto next = dist[v] + length(u, v);
+
+                        if (known[w])
+                            next = std::min(next, update(vectorVerts[u],
+                                                         vectorVerts[v], dist[v],
+                                                         vectorVerts[w],
+                                                         dist[w]));
+
+                        if (next < dist[u])
+                        {
+                            dist[u] = next;
+                            heap.push(next, u);
+                        }
+                    }
+                }
+            }
+        }
+    });
+
+    return fields;
+}
+
+
+// The sparsity pattern is the vertex adjacency plus the diagonal. Every
+// off-diagonal entry keeps the list of angles that face its edge, and
+// every row the list of faces around it, so a new set of positions only
+// needs per-face cotangents and areas and then one gather per row, both
+// of them parallel and free of write conflicts.
+void Laplacian::build(const Verts &verts, const Faces &faces)
+{
+    auto vectorVerts = flatten(verts);
+    auto count = vectorVerts.size();
+    this->vectorFaces = flatten(faces);
+    std::size_t size = 0;
+
+    for (std::size_t i = 0; i != this->vectorFaces.size(); i++)
+    {
+        auto face = this->vectorFaces[i];
+
+        if (face.v1 < count && face.v2 < count && face.v3 < count &&
+            std::isfinite(vectorVerts[face.v1].x) &&
+            std::isfinite(vectorVerts[face.v2].x) &&
+            std::isfinite(vectorVerts[face.v3].x))
+            this->vectorFaces[size++] = face;
+    }
+
+    this->vectorFaces.resize(size);
+
+    std::vector<std::size_t> offsets, neighbors;
+    adjacency(this->vectorFaces, count, offsets, neighbors);
+
+    this->vectorOffsets.assign(count + 1, 0);
+    this->vectorColumns.resize(neighbors.size() + count);
+
+    for (std::size_t v = 0; v != count; v++)
+    {
+        auto next = offsets[v] + v;
+        auto first = neighbors.begin() + offsets[v];
+        auto last = neighbors.begin() + offsets[v + 1];
+        auto middle = std::lower_bound(first, last, v);
+        this->vectorOffsets[v] = next;
+        next = std::copy(first, middle, this->vectorColumns.begin() + next) -
+               this->vectorColumns.begin();
+        this->vectorColumns[next++] = v;
+        std::copy(middle, last, this->vectorColumns.begin() + next);
+    }
+
+    this->vectorOffsets[count] = this->vectorColumns.size();
+
+    auto entry = [this](std::size_t row, std::size_t column) {
+        auto first = this->vectorColumns.begin() + this->vectorOffsets[row];
+        auto last = this->vectorColumns.begin() + this->vectorOffsets[row + 1];
+        return std::size_t(std::lower_bound(first, last, column) -
+                           this->vectorColumns.begin());
+    };
+
+    // The angle at corner k of face f is item 3 * f + k, and it faces the
+    // edge between the other two corners.
+    auto entries = this->vectorColumns.size();
+    this->gatherOffsets.assign(entries + 1, 0);
+    this->incidentOffsets.assign(count + 1, 0);
+
+    for (std::size_t f = 0; f != size; f++)
+    {
+        auto face = this->vectorFaces[f];
+        std::size_t corners[3] = {face.v1, face.v2, face.v3};
+
+        for (std::size_t k = 0; k != 3; k++)
+        {
+            auto u = corners[(k + 1) % 3], v = corners[(k + 2) % 3];
+            this->gatherOffsets[entry(u, v) + 1]++;
+            this->gatherOffsets[entry(v, u) + 1]++;
+            this->incidentOffsets[corners[k] + 1]++;
+        }
+    }
+
+    for (std::size_t i = 0; i != entries; i++)
+        this->gatherOffsets[i + 1] += this->gatherOffsets[i];
+
+    for (std::size_t i = 0; i != count; i++)
+        this->incidentOffsets[i + 1] += this->incidentOffsets[i];
+
+    this->gatherItems.resize(this->gatherOffsets[entries]);
+    this->incidentItems.resize(this->incidentOffsets[count]);
+    std::vector<std::size_t> fill(this->gatherOffsets.begin(),
+                                  this->gatherOffsets.end() - 1);
+    std::vector<std::size_t> fillIncident(this->incidentOffsets.begin(),
+                                          this->incidentOffsets.end() - 1);
+
+    for (std::size_t f = 0; f != size; f++)
+    {
+        auto face = this->vectorFaces[f];
+        std::size_t corners[3] = {face.v1, face.v2, face.v3};
+
+        for (std::size_t k = 0; k != 3; k++)
+        {
+            auto u = corners[(k + 1) % 3], v = corners[(k + 2) % 3];
+            this->gatherItems[fill[entry(u, v)]++] = 3 * f + k;
+            this->gatherItems[fill[entry(v, u)]++] = 3 * f + k;
+            this->incidentItems[fillIncident[corners[k]]++] = f;
+        }
+    }
+
+    this->update(verts);
+}
+
+bool Laplacian::update(const Verts &verts)
+{
+    auto vectorVerts = flatten(verts);
+    auto count = this->vectorOffsets.empty() ? 0
+                                             : this->vectorOffsets.size() - 1;
+
+    if (vectorVerts.size() < count)
+        return false;
+
+    // A corner erased or moved to a non-finite position since build would
+    // turn the weights into INF or NaN, so nothing is updated.
+    auto size = this->vectorFaces.size();
+
+    for (std::size_t f = 0; f != size; f++)
+    {
+        std::size_t corners[3] = {this->vectorFaces[f].v1,
+                                  this->vectorFaces[f].v2,
+                                  this->vectorFaces[f].v3};
+
+        for (std::size_t k = 0; k != 3; k++)
+            if (!std::isfinite(vectorVerts[corners[k]].x) ||
+                !std::isfinite(vectorVerts[corners[k]].y) ||
+                !std::isfinite(vectorVerts[corners[k]].z))
+                return false;
+    }
+
+    this->cots.resize(3 * size);
+    this->areas.resize(size);
+
+    parallel_for(size, 4096, [&](std::size_t begin, std::size_t end) {
+        for (auto f = begin; f != end; f++)
+        {
+            auto face = this->vectorFaces[f];
+            Vert corners[3] = {vectorVerts[face.v1], vectorVerts[face.v2],
+                               vectorVerts[face.v3]};
+            auto n = cross(corners[0], corners[1], corners[2]);
+            auto norm = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+            this->areas[f] = norm / 2;
+
+            for (std::size_t k = 0; k != 3; k++)
+            {
+                auto &c = corners[k];
+                auto &a = corners[(k + 1) % 3], &b = corners[(k + 2) % 3];
+                auto dot = (a.x - c.x) * (b.x - c.x) + (a.y - c.y) * (b.y - c.y) +
+                           (a.z - c.z) * (b.z - c.z);
+                this->cots[3 * f + k] = norm > 0 ? dot / norm : 0;
+            }
+        }
+    });
+
+    this->vectorValues.resize(this->vectorColumns.size());
+    this->vectorMass.resize(count);
+
+    parallel_for(count, 4096, [&](std::size_t begin, std::size_t end) {
+        for (auto v = begin; v != end; v++)
+        {
+            double diagonal = 0;
+            std::size_t at = 0;
+
+            for (auto e = this->vectorOffsets[v]; e != this->vectorOffsets[v + 1];
+                 e++)
+            {
+                if (this->vectorColumns[e] == v)
+                {
+                    at = e;
+                    continue;
+                }
+
+                double weight = 0;
+
+                for (auto i = this->gatherOffsets[e];
+                     i != this->gatherOffsets[e + 1]; i++)
+                    weight += this->cots[this->gatherItems[i]];
+
+                this->vectorValues[e] = -weight / 2;
+                diagonal += weight / 2;
+            }
+
+            this->vectorValues[at] = diagonal;
+
+            double mass = 0;
+
+            for (auto i = this->incidentOffsets[v];
+                 i != this->incidentOffsets[v + 1]; i++)
+                mass += this->areas[this->incidentItems[i]];
+
+            this->vectorMass[v] = mass / 3;
+        }
+    });
+
+    return true;
+}
+
+const std::vector<std::size_t> &Laplacian::offsets() const
+{
+    return this->vectorOffsets;
+}
+
+const std::vector<std::size_t> &Laplacian::columns() const
+{
+    return this->vectorColumns;
+}
+
+const std::vector<double> &Laplacian::values() const
+{
+    return this->vectorValues;
+}
+
+const std::vector<double> &Laplacian::mass() const
+{
+    return this->vectorMass;
+}
@@ -0,0 +1,83 @@
+#ifndef GEOM_H
+#define GEOM_H
+
+#ifdef __WIN32__
+#ifdef BUILD_LIB
+#define LIB_CLASS __declspec(dllexport)
+#else
+#define LIB_CLASS __declspec(dllimport)
+#endif
+#else
+#define LIB_CLASS
+#endif
+
+#include "mesh.h"
+
+
+class LIB_CLASS Geom
+{
+public:
+    static std::vector<std::size_t> reorder(Verts &, Faces &, Edges &);
+    static void optimize(Face *, std::size_t, std::size_t);
+    static double acmr(const Face *, std::size_t, std::size_t);
+
+    static void bounds(const Verts &, Vert &, Vert &);
+    static void measure(const Verts &, const Faces &,
+                        double &, double &, Vert &);
+    static double area(const Verts &, const Faces &);
+    static double volume(const Verts &, const Faces &);
+    static Vert centroid(const Verts &, const Faces &);
+
+    static std::size_t simplify(Verts &, Faces &, std::size_t, double);
+    static std::size_t simplify(Verts &, Faces &, Edges &,
+                                std::size_t, double);
+
+    static void subdivide(Verts &, Faces &, const Vert &);
+    static void subdivide(std::vector<Vert> &, std::vector<Face> &,
+                          const Vert &);
+    static void loop(Verts &, Faces &);
+    static void loop(std::vector<Vert> &, std::vector<Face> &);
+
+    static void smooth(Verts &, const Faces &, std::size_t, double, double);
+    static void smooth(Verts &, const Faces &, std::size_t, double, double,
+                       const std::vector<double> &);
+
+    static std::vector<std::pair<Face, Face>> intersect(const Verts &,
+                                                        const Faces &);
+
+    static std::vector<double> geodesic(const Verts &, const Faces &,
+                                        const std::vector<std::size_t> &,
+                                        bool);
+    static std::vector<std::vector<double>> geodesic(
+        const Verts &, const Faces &,
+        const std::vector<std::vector<std::size_t>> &, bool);
+};
+
+
+class LIB_CLASS Laplacian
+{
+    std::vector<Face> vectorFaces;
+    std::vector<std::size_t> gatherOffsets;
+    std::vector<std::size_t> gatherItems;
+    std::vector<std::size_t> incidentOffsets;
+    std::vector<std::size_t> incidentItems;
+    std::vector<double> cots;
+    std::vector<double> areas;
+
+    std::vector<std::size_t> vectorOffsets;
+    std::vector<std::size_t> vectorColumns;
+    std::vector<double> vectorValues;
+    std::vector<double> vectorMass;
+
+public:
+    void build(const Verts &, const Faces &);
+    bool update(const Verts &);
+
+    const std::vector<std::size_t> &offsets() const;
+    const std::vector<std::size_t> &columns() const;
+    const std::vector<double> &values() const;
+    const std::vector<double> &mass() const;
+};
+
+
+#endif
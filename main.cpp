@@ -1,241 +1,1909 @@
-#include "mesh.h"
-#include "file.h"
-#include <iostream>
-#include <vector>
-#include <cstdlib>
-
-
-void print(const std::set<Edge> &set, const std::string &padding)
-{
-   if (set.empty())
-      std::cout << padding
-                << "Searched edges are empty." << std::endl;
-   else
-      for (auto iter = set.cbegin(); iter != set.cend(); iter++)
-         std::cout << padding
-                   << iter->v1 << "," << iter->v2 << std::endl;
-}
-
-void print(const std::map<Face, void *> &map, const std::string &padding)
-{
-   if (map.empty())
-      std::cout << "Searched faces are empty." << std::endl;
-   else
-      for (auto iter = map.cbegin(); iter != map.cend(); iter++)
-         std::cout << padding
-                   << iter->first.v1 << ","
-                   << iter->first.v2 << ","
-                   << iter->first.v3 << std::endl;
-}
-
-
-int main()
-{
-   Verts verts;
-   Faces faces;
-   File::read_verts("verts.txt", verts);
-   File::read_faces("faces.txt", faces);
-
-   std::cout << "Total verts: " << verts.size() << std::endl;
-   std::cout << "Total faces: " << faces.size() << std::endl;
-
-
-   /* Test 1-1. Erasing a vertex with 4 neighbors.
-       The vertex to be deleted will be one of the 6 starting vertices
-       of the seeding octahedron.
-       The total count of faces after deletion should decrease by 4.
-    */
-   std::cout << "\n\nTest 1-1. Size should decrease by 4." << std::endl;
-
-   std::cout << "  Total faces before: " << faces.size() << std::endl;
-   faces.erase(0); // (-2, 0, 0) connecting to 4 neighbors.
-   std::cout << "  Total faces after:  " << faces.size() << std::endl;
-
-   /* Test 1-2. Erasing a vertex with 6 neighbors.
-       All the vertices that are not part of the original 6 vertices
-       of the seeding octahedron have 6 neighboring points.
-       Unless these selected vertices are adjacent to each other,
-       deleting a vertex will decrase the face counts by 6 on each deletion.
-    */
-   std::cout << "\nTest 1-2. Size should decrease by 6 each time."
-             << std::endl;
-
-   std::cout << "  Total faces before:  " << faces.size() << std::endl;
-   faces.erase(14973);
-   std::cout << "  Total faces after 1: " << faces.size() << std::endl;
-   faces.erase(40525);
-   std::cout << "  Total faces after 2: " << faces.size() << std::endl;
-   faces.erase(28356);
-   std::cout << "  Total faces after 3: " << faces.size() << std::endl;
-   faces.erase(45177);
-   std::cout << "  Total faces after 4: " << faces.size() << std::endl;
-   faces.erase(62428);
-   std::cout << "  Total faces after 5: " << faces.size() << std::endl;
-
-
-   /* Test 2-1. Erasing random edges.
-       When deleting non-adjacent edges that are far away from each other
-       the number of faces should decrease by 2, because 1 edge is
-       shared by 2 triangle faces.
-    */
-   std::cout << "\n\nTest 2-1. Size should decrease by 2 each time."
-             << std::endl;
-
-   std::cout << "  Total faces before:  " << faces.size() << std::endl;
-   faces.erase(Edge(39508, 39960));
-   std::cout << "  Total faces after 1: " << faces.size() << std::endl;
-   faces.erase(Edge(37217, 36745));
-   std::cout << "  Total faces after 2: " << faces.size() << std::endl;
-   faces.erase(Edge(46935, 46931));
-   std::cout << "  Total faces after 3: " << faces.size() << std::endl;
-   faces.erase(Edge(1359, 1343));
-   std::cout << "  Total faces after 4: " << faces.size() << std::endl;
-   faces.erase(Edge(27702, 27236));
-   std::cout << "  Total faces after 5: " << faces.size() << std::endl;
-
-   /* Test 2-2. Erasing 2 edges of the same triangle.
-       In this case the second edge getting deleted only affects 1 face.
-       The number of faces should decrease by 2 then 1.
-    */
-   std::cout << "\nTest 2-2. Size should decrease by 2 then 1."
-             << std::endl;
-
-   std::cout << "  Total faces before:  " << faces.size() << std::endl;
-   faces.erase(Edge(9701, 9999));
-   std::cout << "  Total faces after 1: " << faces.size() << std::endl;
-   faces.erase(Edge(9999, 9931));
-   std::cout << "  Total faces after 2: " << faces.size() << std::endl;
-
-
-   /* Test 3. Erasing faces.
-       The main purpose of tests below is to ensure the equivalent faces
-       are properly recognized by deletion algorithm.
-       For example Face(v1, v2, v3) is the same as
-       Face(v2, v3, v1) and Face(v3, v1, v2) however
-       Face(v1, v2, v3) is NOT the same as Face(v3, v2, v1).
-
-       This distinction is in place for determining the normal vector
-       of the face represeting the surface angle to reflect light.
-
-       In this scenario the number of faces should decrease by
-       1, 1, 1 then 0, 1.
-       The first 3 deletions will be testing whether each rotation of
-       the vertices is correctly recognized and the last 2 cases will
-       test deletion of triangles in reversed vertex order.
-    */
-   std::cout << "\n\nTest 3. Size should decrease by 1, 1, 1, 0, 1."
-             << std::endl;
-
-   std::cout << "  Total faces before:  " << faces.size() << std::endl;
-   faces.erase(Face(30950, 30454, 30462)); // (v1, v2, v3)
-   std::cout << "  Total faces after 1: " << faces.size() << std::endl;
-   faces.erase(Face(38961, 38497, 38505)); // (v2, v3, v1)
-   std::cout << "  Total faces after 2: " << faces.size() << std::endl;
-   faces.erase(Face(50807, 50839, 50523)); // (v3, v1, v2)
-   std::cout << "  Total faces after 3: " << faces.size() << std::endl;
-   faces.erase(Face(45178, 45194, 45574)); // reversed order
-   std::cout << "  Total faces after 4: " << faces.size() << std::endl;
-   faces.erase(Face(45574, 45194, 45178)); // correct order
-   std::cout << "  Total faces after 5: " << faces.size() << std::endl;
-
-
-   /* Test 4. Testing if Edges class can properly handle the changing mesh.
-       The first edges object will update everytime a change happens whereas
-       the second edges object will synchronize edges once at the end.
-
-       However the results should be exactly the same.
-    */
-   std::cout << "\n\nTest 4. Two edges should be identical." << std::endl;
-
-   verts.clear();
-   faces.clear();
-
-   Faces faces1, faces2;
-   File::read_verts("verts.txt", verts);
-   File::read_faces("faces.txt", faces1);
-   faces2 = faces1;
-
-   Edges edges1, edges2;
-   faces1.sync(edges1);
-
-   // edges1 is updated on every operation.
-   faces1.erase(31024, edges1);
-   faces1.erase(48614, edges1);
-   faces1.erase(Edge(15902, 16230), edges1);
-   faces1.erase(Edge(20105, 20121), edges1);
-   faces1.erase(Edge(16248, 15928), edges1);
-   faces1.erase(Edge(46975, 46575), edges1);
-   faces1.erase(Face(12592, 12528, 12796), edges1);
-   faces1.erase(Face(9303, 9327, 9579), edges1);
-   faces1.erase(Face(49544, 49532, 49204), edges1);
-
-   // edges2 is updated once at the end.
-   faces2.erase(31024);
-   faces2.erase(48614);
-   faces2.erase(Edge(15902, 16230));
-   faces2.erase(Edge(20121, 20105)); // order changed
-   faces2.erase(Edge(16248, 15928));
-   faces2.erase(Edge(46575, 46975)); // order changed
-   faces2.erase(Face(12592, 12528, 12796));
-   faces2.erase(Face(9327, 9579, 9303));    // order changed
-   faces2.erase(Face(49204, 49544, 49532)); // order changed
-   faces2.sync(edges2);
-
-   // Converting edges to std::vector for easy comparison.
-   std::vector<Edge> vector1, vector2;
-   vector1.resize(edges1.size());
-   vector2.resize(edges2.size());
-   edges1.copy_all(&vector1[0]);
-   edges2.copy_all(&vector2[0]);
-   std::cout << "  Identical: "
-             << (vector1 == vector2 ? "Yes" : "No") << std::endl;
-
-
-   /* Test 5-1. Searching based on Vert.
-       The vertex picked as the search input makes up 6 faces.
-    */
-   std::cout << "\n\nTest 5-1. Result should have 6 faces." << std::endl;
-
-   auto result1 = faces1.search(56691);
-   print(result1, "  ");
-
-   /* Test 5-2. Searching based on Edge.
-       Every edge making up the octasphere is touching 2 faces.
-    */
-   std::cout << "\nTest 5-2. Result should have 2 faces." << std::endl;
-
-   auto result2 = faces1.search(Edge(11290, 11086));
-   print(result2, "  ");
-
-
-   /* Test 6. Searching for indices from Verts using (x, y, z) coord.
-       Because in the original vertices dataset there are no duplicates.
-       So I simply inserted 3 identical points to the end of verts.
-    */
-   std::cout << "\n\nTest 6. Result length should be 3." << std::endl;
-
-   // Insert 3 identical points to verts.
-   verts.insert(Vert(-1.6, 2, 4.8));
-   verts.insert(Vert(-1.6, 2, 4.8));
-   verts.insert(Vert(-1.6, 2, 4.8));
-
-   auto result = verts.search(Vert(-1.6, 2, 4.8));
-   std::cout << "  Length: " << result.size() << std::endl;
-
-
-   /* Test 7. File writing test.
-       Write all the verts.
-       Write all the edges.
-       Write all the faces.
-    */
-   std::cout << "\n\nTest 7. File output test." << std::endl;
-
-   File::write_verts(verts, "output_verts.txt");
-   File::write_edges(edges1, "output_edges.txt");
-   File::write_faces(faces1, "output_faces.txt");
-
-
-   system("pause");
-
-   return 0;
-}
\ No newline at end of file
+#include "mesh.h"
+#include "file.h"
+#include "geom.h"
+#include "topo.h"
+#include "share.h"
+#include "pack.h"
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <iomanip>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <thread>
+
+
+void print(const std::set<Edge> &set, const std::string &padding)
+{
+   if (set.empty())
+      std::cout << padding
+                << "Searched edges are empty." << std::endl;
+   else
+      for (auto iter = set.cbegin(); iter != set.cend(); iter++)
+         std::cout << padding
+                   << iter->v1 << "," << iter->v2 << std::endl;
+}
+
+double traverse(const Verts &verts, const Faces &faces)
+{
+   std::vector<Vert> vectorVerts(verts.size());
+   std::vector<std::size_t> vectorIdx(verts.size());
+   std::vector<Face> vectorFaces(faces.size());
+   std::vector<void *> vectorPtr(faces.size());
+   verts.copy_all(&vectorIdx[0], &vectorVerts[0]);
+   faces.copy_all(&vectorFaces[0], &vectorPtr[0]);
+
+   auto start = std::chrono::steady_clock::now();
+   volatile double sum = 0;
+
+   for (int repeat = 0; repeat != 10; repeat++)
+      for (std::size_t i = 0; i != vectorFaces.size(); i++)
+         sum = sum + vectorVerts[vectorFaces[i].v1].x +
+               vectorVerts[vectorFaces[i].v2].x +
+               vectorVerts[vectorFaces[i].v3].x;
+
+   auto end = std::chrono::steady_clock::now();
+   return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+std::size_t lines(const std::string &filename)
+{
+   std::ifstream fin(filename.c_str());
+   std::string line;
+   std::size_t count = 0;
+
+   while (std::getline(fin, line))
+      count++;
+
+   return count;
+}
+
+void print(const std::map<std::string, std::size_t> &map,
+           const std::string &padding)
+{
+   for (auto iter = map.cbegin(); iter != map.cend(); iter++)
+      std::cout << padding << iter->first << ": "
+                << iter->second << " bytes" << std::endl;
+}
+
+void print(const std::map<Face, void *> &map, const std::string &padding)
+{
+   if (map.empty())
+      std::cout << "Searched faces are empty." << std::endl;
+   else
+      for (auto iter = map.cbegin(); iter != map.cend(); iter++)
+         std::cout << padding
+                   << iter->first.v1 << ","
+                   << iter->first.v2 << ","
+                   << iter->first.v3 << std::endl;
+}
+
+
+int main()
+{
+   Verts verts;
+   Faces faces;
+   File::read_verts("verts.txt", verts);
+   File::read_faces("faces.txt", faces);
+
+   std::cout << "Total verts: " << verts.size() << std::endl;
+   std::cout << "Total faces: " << faces.size() << std::endl;
+
+
+   /* Test 1-1. Erasing a vertex with 4 neighbors.
+       The vertex to be deleted will be one of the 6 starting vertices
+       of the seeding octahedron.
+       The total count of faces after deletion should decrease by 4.
+    */
+   std::cout << "\n\nTest 1-1. Size should decrease by 4." << std::endl;
+
+   std::cout << "  Total faces before: " << faces.size() << std::endl;
+   faces.erase(0); // (-2, 0, 0) connecting to 4 neighbors.
+   std::cout << "  Total faces after:  " << faces.size() << std::endl;
+
+   /* Test 1-2. Erasing a vertex with 6 neighbors.
+       All the vertices that are not part of the original 6 vertices
+       of the seeding octahedron have 6 neighboring points.
+       Unless these selected vertices are adjacent to each other,
+       deleting a vertex will decrase the face counts by 6 on each deletion.
+    */
+   std::cout << "\nTest 1-2. Size should decrease by 6 each time."
+             << std::endl;
+
+   std::cout << "  Total faces before:  " << faces.size() << std::endl;
+   faces.erase(14973);
+   std::cout << "  Total faces after 1: " << faces.size() << std::endl;
+   faces.erase(40525);
+   std::cout << "  Total faces after 2: " << faces.size() << std::endl;
+   faces.erase(28356);
+   std::cout << "  Total faces after 3: " << faces.size() << std::endl;
+   faces.erase(45177);
+   std::cout << "  Total faces after 4: " << faces.size() << std::endl;
+   faces.erase(62428);
+   std::cout << "  Total faces after 5: " << faces.size() << std::endl;
+
+
+   /* Test 2-1. Erasing random edges.
+       When deleting non-adjacent edges that are far away from each other
+       the number of faces should decrease by 2, because 1 edge is
+       shared by 2 triangle faces.
+    */
+   std::cout << "\n\nTest 2-1. Size should decrease by 2 each time."
+             << std::endl;
+
+   std::cout << "  Total faces before:  " << faces.size() << std::endl;
+   faces.erase(Edge(39508, 39960));
+   std::cout << "  Total faces after 1: " << faces.size() << std::endl;
+   faces.erase(Edge(37217, 36745));
+   std::cout << "  Total faces after 2: " << faces.size() << std::endl;
+   faces.erase(Edge(46935, 46931));
+   std::cout << "  Total faces after 3: " << faces.size() << std::endl;
+   faces.erase(Edge(1359, 1343));
+   std::cout << "  Total faces after 4: " << faces.size() << std::endl;
+   faces.erase(Edge(27702, 27236));
+   std::cout << "  Total faces after 5: " << faces.size() << std::endl;
+
+   /* Test 2-2. Erasing 2 edges of the same triangle.
+       In this case the second edge getting deleted only affects 1 face.
+       The number of faces should decrease by 2 then 1.
+    */
+   std::cout << "\nTest 2-2. Size should decrease by 2 then 1."
+             << std::endl;
+
+   std::cout << "  Total faces before:  " << faces.size() << std::endl;
+   faces.erase(Edge(9701, 9999));
+   std::cout << "  Total faces after 1: " << faces.size() << std::endl;
+   faces.erase(Edge(9999, 9931));
+   std::cout << "  Total faces after 2: " << faces.size() << std::endl;
+
+
+   /* Test 3. Erasing faces.
+       The main purpose of tests below is to ensure the equivalent faces
+       are properly recognized by deletion algorithm.
+       For example Face(v1, v2, v3) is the same as
+       Face(v2, v3, v1) and Face(v3, v1, v2) however
+       Face(v1, v2, v3) is NOT the same as Face(v3, v2, v1).
+
+       This distinction is in place for determining the normal vector
+       of the face represeting the surface angle to reflect light.
+
+       In this scenario the number of faces should decrease by
+       1, 1, 1 then 0, 1.
+       The first 3 deletions will be testing whether each rotation of
+       the vertices is correctly recognized and the last 2 cases will
+       test deletion of triangles in reversed vertex order.
+    */
+   std::cout << "\n\nTest 3. Size should decrease by 1, 1, 1, 0, 1."
+             << std::endl;
+
+   std::cout << "  Total faces before:  " << faces.size() << std::endl;
+   faces.erase(Face(30950, 30454, 30462)); // (v1, v2, v3)
+   std::cout << "  Total faces after 1: " << faces.size() << std::endl;
+   faces.erase(Face(38961, 38497, 38505)); // (v2, v3, v1)
+   std::cout << "  Total faces after 2: " << faces.size() << std::endl;
+   faces.erase(Face(50807, 50839, 50523)); // (v3, v1, v2)
+   std::cout << "  Total faces after 3: " << faces.size() << std::endl;
+   faces.erase(Face(45178, 45194, 45574)); // reversed order
+   std::cout << "  Total faces after 4: " << faces.size() << std::endl;
+   faces.erase(Face(45574, 45194, 45178)); // correct order
+   std::cout << "  Total faces after 5: " << faces.size() << std::endl;
+
+
+   /* Test 4. Testing if Edges class can properly handle the changing mesh.
+       The first edges object will update everytime a change happens whereas
+       the second edges object will synchronize edges once at the end.
+
+       However the results should be exactly the same.
+    */
+   std::cout << "\n\nTest 4. Two edges should be identical." << std::endl;
+
+   verts.clear();
+   faces.clear();
+
+   Faces faces1, faces2;
+   File::read_verts("verts.txt", verts);
+   File::read_faces("faces.txt", faces1);
+   faces2 = faces1;
+
+   Edges edges1, edges2;
+   faces1.sync(edges1);
+
+   // edges1 is updated on every operation.
+   faces1.erase(31024, edges1);
+   faces1.erase(48614, edges1);
+   faces1.erase(Edge(15902, 16230), edges1);
+   faces1.erase(Edge(20105, 20121), edges1);
+   faces1.erase(Edge(16248, 15928), edges1);
+   faces1.erase(Edge(46975, 46575), edges1);
+   faces1.erase(Face(12592, 12528, 12796), edges1);
+   faces1.erase(Face(9303, 9327, 9579), edges1);
+   faces1.erase(Face(49544, 49532, 49204), edges1);
+
+   // edges2 is updated once at the end.
+   faces2.erase(31024);
+   faces2.erase(48614);
+   faces2.erase(Edge(15902, 16230));
+   faces2.erase(Edge(20121, 20105)); // order changed
+   faces2.erase(Edge(16248, 15928));
+   faces2.erase(Edge(46575, 46975)); // order changed
+   faces2.erase(Face(12592, 12528, 12796));
+   faces2.erase(Face(9327, 9579, 9303));    // order changed
+   faces2.erase(Face(49204, 49544, 49532)); // order changed
+   faces2.sync(edges2);
+
+   // Converting edges to std::vector for easy comparison.
+   std::vector<Edge> vector1, vector2;
+   vector1.resize(edges1.size());
+   vector2.resize(edges2.size());
+   edges1.copy_all(&vector1[0]);
+   edges2.copy_all(&vector2[0]);
+   std::cout << "  Identical: "
+             << (vector1 == vector2 ? "Yes" : "No") << std::endl;
+
+
+   /* Test 5-1. Searching based on Vert.
+       The vertex picked as the search input makes up 6 faces.
+    */
+   std::cout << "\n\nTest 5-1. Result should have 6 faces." << std::endl;
+
+   auto result1 = faces1.search(56691);
+   print(result1, "  ");
+
+   /* Test 5-2. Searching based on Edge.
+       Every edge making up the octasphere is touching 2 faces.
+    */
+   std::cout << "\nTest 5-2. Result should have 2 faces." << std::endl;
+
+   auto result2 = faces1.search(Edge(11290, 11086));
+   print(result2, "  ");
+
+
+   /* Test 6. Searching for indices from Verts using (x, y, z) coord.
+       Because in the original vertices dataset there are no duplicates.
+       So I simply inserted 3 identical points to the end of verts.
+    */
+   std::cout << "\n\nTest 6. Result length should be 3." << std::endl;
+
+   // Insert 3 identical points to verts.
+   verts.insert(Vert(-1.6, 2, 4.8));
+   verts.insert(Vert(-1.6, 2, 4.8));
+   verts.insert(Vert(-1.6, 2, 4.8));
+
+   auto result = verts.search(Vert(-1.6, 2, 4.8));
+   std::cout << "  Length: " << result.size() << std::endl;
+
+
+   /* Test 7. File writing test.
+       Write all the verts.
+       Write all the edges.
+       Write all the faces.
+    */
+   std::cout << "\n\nTest 7. File output test." << std::endl;
+
+   File::write_verts(verts, "output_verts.txt");
+   File::write_edges(edges1, "output_edges.txt");
+   File::write_faces(faces1, "output_faces.txt");
+
+
+   /* Test 8. Compacting indices after deletions.
+       Vertices 31024 and 48614 were erased from faces1 in test 4.
+       Erasing them from verts as well leaves 2 holes in the index space.
+       After compaction the indices are dense again, every other count
+       is unchanged and vertex 56691 from test 5-1 becomes 56689.
+       A map sending two vertices to one index is refused.
+    */
+   std::cout << "\n\nTest 8. Dense indices, 56691 -> 56689, folding refused."
+             << std::endl;
+
+   verts.erase(31024);
+   verts.erase(48614);
+   auto sizeVerts = verts.size();
+   auto sizeEdges = edges1.size();
+   auto sizeFaces = faces1.size();
+   auto map = verts.compact(faces1, edges1);
+
+   std::cout << "  Dense:     "
+             << (map.back() + 1 == sizeVerts ? "Yes" : "No") << std::endl;
+   std::cout << "  Unchanged: "
+             << (edges1.size() == sizeEdges && faces1.size() == sizeFaces
+                     ? "Yes"
+                     : "No")
+             << std::endl;
+   std::cout << "  Mapped:    " << map[56691] << std::endl;
+   print(faces1.search(map[56691]), "    ");
+
+   std::vector<std::size_t> folded(map.size());
+   for (std::size_t i = 0; i != folded.size(); i++)
+      folded[i] = i / 2;
+   std::cout << "  Refused:   "
+             << (!faces1.renumber(folded) && !edges1.renumber(folded) &&
+                         faces1.size() == sizeFaces && faces1.verify()
+                     ? "Yes"
+                     : "No")
+             << std::endl;
+
+
+   /* Test 9. Reordering for cache locality.
+       Vertices are renumbered along a Morton curve and then by first use
+       in a vertex cache optimized face sequence.
+       The ACMR (vertex cache misses per face) of the stored face order
+       should drop from about 2 to below 1 and nothing should be lost.
+       The mesh subdivided once and numbered at random, 6 MB of
+       coordinates that do not fit in a 2 MB cache, is reordered too.
+       The time is 10 passes over the faces reading flat coordinates,
+       which should be faster after reordering.
+    */
+   std::cout << "\n\nTest 9. ACMR should drop below 1." << std::endl;
+
+   verts.clear();
+   faces.clear();
+   edges1.clear();
+   File::read_verts("verts.txt", verts);
+   File::read_faces("faces.txt", faces);
+   faces.sync(edges1);
+
+   std::vector<Face> vectorFaces(faces.size());
+   std::vector<void *> vectorPtr(faces.size());
+   faces.copy_all(&vectorFaces[0], &vectorPtr[0]);
+   std::cout << "  ACMR before: "
+             << Geom::acmr(&vectorFaces[0], vectorFaces.size(), 16)
+             << std::endl;
+
+   sizeVerts = verts.size();
+   sizeEdges = edges1.size();
+   sizeFaces = faces.size();
+   Geom::reorder(verts, faces, edges1);
+
+   faces.copy_all(&vectorFaces[0], &vectorPtr[0]);
+   std::cout << "  ACMR after:  "
+             << Geom::acmr(&vectorFaces[0], vectorFaces.size(), 16)
+             << std::endl;
+   std::cout << "  Unchanged:   "
+             << (verts.size() == sizeVerts && edges1.size() == sizeEdges &&
+                         faces.size() == sizeFaces
+                     ? "Yes"
+                     : "No")
+             << std::endl;
+
+   std::vector<Vert> largeVerts(verts.size());
+   std::vector<Face> largeFaces(vectorFaces);
+   verts.copy_all(&largeVerts[0]);
+   Geom::subdivide(largeVerts, largeFaces, Vert(0, 0, 0));
+
+   std::vector<std::size_t> shuffled(largeVerts.size());
+   std::mt19937 shuffler(9);
+
+   for (std::size_t i = 0; i != shuffled.size(); i++)
+      shuffled[i] = i;
+
+   std::shuffle(shuffled.begin(), shuffled.end(), shuffler);
+
+   std::vector<Vert> shuffledVerts(largeVerts.size());
+   Verts bigVerts;
+   Faces bigFaces;
+   Edges bigEdges;
+
+   for (std::size_t i = 0; i != largeVerts.size(); i++)
+      shuffledVerts[shuffled[i]] = largeVerts[i];
+
+   bigVerts.defer(true);
+   bigFaces.defer(true);
+
+   for (std::size_t i = 0; i != shuffledVerts.size(); i++)
+      bigVerts.insert(shuffledVerts[i]);
+
+   for (std::size_t i = 0; i != largeFaces.size(); i++)
+      bigFaces.insert(Face(shuffled[largeFaces[i].v1],
+                           shuffled[largeFaces[i].v2],
+                           shuffled[largeFaces[i].v3]),
+                      nullptr);
+
+   bigVerts.defer(false);
+   bigFaces.defer(false);
+   bigFaces.sync(bigEdges);
+
+   auto before = traverse(bigVerts, bigFaces);
+   Geom::reorder(bigVerts, bigFaces, bigEdges);
+   auto after = traverse(bigVerts, bigFaces);
+   std::cout << "  Large:       " << bigFaces.size() << " faces, "
+             << (after < before ? "faster" : "slower") << std::endl;
+   std::cout << "  Time:        " << before << " ms before, " << after
+             << " ms after" << std::endl;
+   bigVerts.clear();
+   bigFaces.clear();
+   bigEdges.clear();
+
+
+   /* Test 10. Memory accounting.
+       Every internal index reports the bytes it holds including the
+       tree nodes and the allocator overhead.
+       On a 64 bit build every node of the 3 face indexes takes 80 bytes,
+       64 bytes of links and value plus the allocator header and padding.
+    */
+   std::cout << "\n\nTest 10. Face index nodes should take 80 bytes."
+             << std::endl;
+
+   print(verts.memory(), "  ");
+   print(edges1.memory(), "  ");
+   print(faces.memory(), "  ");
+
+
+   /* Test 11. One-ring traversal.
+       The neighbors of vertex 56689 from test 8 come back in winding order
+       and the ring is closed.
+       A fan of 3 triangles inserted in shuffled order is open, so its
+       center is a boundary vertex with 4 neighbors 1, 2, 3, 4.
+       With room for 2 faces the call reports the 3 faces and 4 neighbors
+       it needs.
+       Two closed cones touching at their tip pinch it, which is not a
+       boundary but is not manifold either.
+    */
+   std::cout << "\n\nTest 11. Closed, open 1,2,3,4, needs 3 and 4, pinched."
+             << std::endl;
+
+   Face ringFaces[8];
+   std::size_t ringVerts[8];
+   std::size_t countFaces = 8, countVerts = 8;
+   bool manifold = false;
+   auto boundary = faces1.ring(map[56691], ringFaces, countFaces,
+                               ringVerts, countVerts, manifold);
+
+   std::cout << "  Boundary: " << (boundary ? "Yes" : "No")
+             << ", manifold: " << (manifold ? "Yes" : "No") << std::endl;
+   std::cout << "  Ring:    ";
+
+   for (std::size_t i = 0; i != countVerts; i++)
+      std::cout << " " << ringVerts[i];
+
+   Faces fan;
+   fan.insert(Face(0, 3, 4), nullptr);
+   fan.insert(Face(0, 1, 2), nullptr);
+   fan.insert(Face(3, 0, 2), nullptr);
+   countFaces = 8, countVerts = 8;
+   boundary = fan.ring(0, ringFaces, countFaces, ringVerts, countVerts,
+                       manifold);
+
+   std::cout << "\n  Boundary: " << (boundary ? "Yes" : "No")
+             << ", manifold: " << (manifold ? "Yes" : "No") << std::endl;
+   std::cout << "  Ring:    ";
+
+   for (std::size_t i = 0; i != countVerts; i++)
+      std::cout << " " << ringVerts[i];
+
+   countFaces = 2, countVerts = 2;
+   fan.ring(0, ringFaces, countFaces, ringVerts, countVerts, manifold);
+   std::cout << "\n  Needs:    " << countFaces << " faces, " << countVerts
+             << " verts" << std::endl;
+
+   Faces cones;
+   cones.insert(Face(0, 1, 2), nullptr);
+   cones.insert(Face(0, 2, 3), nullptr);
+   cones.insert(Face(0, 3, 1), nullptr);
+   cones.insert(Face(0, 4, 5), nullptr);
+   cones.insert(Face(0, 5, 6), nullptr);
+   cones.insert(Face(0, 6, 4), nullptr);
+   countFaces = 8, countVerts = 8;
+   boundary = cones.ring(0, ringFaces, countFaces, ringVerts, countVerts,
+                         manifold);
+
+   std::cout << "  Boundary: " << (boundary ? "Yes" : "No")
+             << ", manifold: " << (manifold ? "Yes" : "No") << std::endl;
+   std::cout << "  Ring:    ";
+
+   for (std::size_t i = 0; i != countVerts; i++)
+      std::cout << " " << ringVerts[i];
+
+   std::cout << std::endl;
+
+
+   /* Test 12. Geometric reductions.
+       The octasphere has radius 2 so the bounds are (-2, -2, -2) and
+       (2, 2, 2), the area and volume are close to 16 pi = 50.27 and
+       32 pi / 3 = 33.51 and the centroid is close to the origin.
+       With vertex 0 erased the faces around it are left out, and the
+       area stays finite and drops a little.
+    */
+   std::cout << "\n\nTest 12. Area 50.27, volume 33.51, centroid 0, Yes."
+             << std::endl;
+
+   Vert lower, upper, centroid;
+   double area, volume;
+   Geom::bounds(verts, lower, upper);
+   Geom::measure(verts, faces, area, volume, centroid);
+
+   std::cout << "  Lower:    " << lower.x << ", " << lower.y << ", "
+             << lower.z << std::endl;
+   std::cout << "  Upper:    " << upper.x << ", " << upper.y << ", "
+             << upper.z << std::endl;
+   std::cout << "  Area:     " << area << std::endl;
+   std::cout << "  Volume:   " << volume << std::endl;
+   std::cout << "  Centroid: " << centroid.x << ", " << centroid.y << ", "
+             << centroid.z << std::endl;
+
+   Verts holedVerts = verts;
+   holedVerts.erase(0);
+   auto holed = Geom::area(holedVerts, faces);
+   std::cout << "  Erased:   "
+             << (std::isfinite(holed) && holed < area && holed > area - 1
+                    ? "Yes" : "No")
+             << std::endl;
+
+
+   /* Test 13. Boundary analysis.
+       faces1 lost 2 vertices, 4 edges and 3 faces in test 4, which leaves
+       holes bounded by loops of 6, 6, 4, 4, 4, 4, 3, 3 and 3 edges
+       in no particular order.
+       The fan from test 11 has a single open loop 0, 1, 2, 3, 4 and
+       nothing in either mesh is non-manifold.
+       The cones from test 11 pinch vertex 0, and 2 faces running the same
+       way along their shared edge are flagged as flipped.
+    */
+   std::cout << "\n\nTest 13. Loops of 6, 6, 4, 4, 4, 4, 3, 3, 3 then 5, "
+             << "1 pinched, 1 flipped." << std::endl;
+
+   std::vector<Edge> boundaryEdges, nonManifoldEdges, flippedEdges;
+   std::vector<std::size_t> boundaryVerts, nonManifoldVerts;
+   std::vector<std::vector<std::size_t>> loops;
+   Topo::analyze(faces1, boundaryEdges, nonManifoldEdges,
+                 flippedEdges, boundaryVerts, nonManifoldVerts, loops);
+
+   std::cout << "  Loops:        ";
+
+   for (std::size_t i = 0; i != loops.size(); i++)
+      std::cout << " " << loops[i].size();
+
+   std::cout << "\n  Non-manifold:  " << nonManifoldEdges.size() << ", "
+             << nonManifoldVerts.size() << std::endl;
+
+   Topo::analyze(fan, boundaryEdges, nonManifoldEdges,
+                 flippedEdges, boundaryVerts, nonManifoldVerts, loops);
+
+   std::cout << "  Loops:        ";
+
+   for (std::size_t i = 0; i != loops.size(); i++)
+      std::cout << " " << loops[i].size();
+
+   std::cout << "\n  Non-manifold:  " << nonManifoldEdges.size() << ", "
+             << nonManifoldVerts.size() << std::endl;
+
+   Topo::analyze(cones, boundaryEdges, nonManifoldEdges,
+                 flippedEdges, boundaryVerts, nonManifoldVerts, loops);
+   std::cout << "  Pinched:       " << nonManifoldEdges.size() << ", "
+             << nonManifoldVerts.size() << std::endl;
+
+   Faces flippedFaces;
+   flippedFaces.insert(Face(0, 1, 2), nullptr);
+   flippedFaces.insert(Face(2, 0, 3), nullptr);
+   Topo::analyze(flippedFaces, boundaryEdges, nonManifoldEdges,
+                 flippedEdges, boundaryVerts, nonManifoldVerts, loops);
+   std::cout << "  Flipped:       " << flippedEdges.size() << ", "
+             << nonManifoldEdges.size() << std::endl;
+
+
+   /* Test 14. Connected components.
+       Cutting the octasphere along the equator z = 0 by erasing every
+       vertex on it splits the mesh into 2 halves of equal size.
+       The fan from test 11 is added to the same Faces as a third piece.
+    */
+   std::cout << "\n\nTest 14. Should be 3 components, 2 equal."
+             << std::endl;
+
+   Faces cut = faces;
+   std::vector<Vert> vectorVerts(verts.size());
+   std::vector<std::size_t> vectorIdx(verts.size());
+   verts.copy_all(&vectorIdx[0], &vectorVerts[0]);
+
+   for (std::size_t i = 0; i != vectorVerts.size(); i++)
+      if (vectorVerts[i].z == 0)
+         cut.erase(vectorIdx[i]);
+
+   cut.insert(Face(70000, 70003, 70004), nullptr);
+   cut.insert(Face(70000, 70001, 70002), nullptr);
+   cut.insert(Face(70003, 70000, 70002), nullptr);
+
+   std::vector<Faces> parts;
+   Topo::components(cut, parts);
+
+   for (std::size_t i = 0; i != parts.size(); i++)
+      std::cout << "  Component " << i << ": " << parts[i].size()
+                << std::endl;
+
+
+   /* Test 15. Quadric error simplification.
+       The octasphere is reduced to 10% of its faces.
+       The area and volume should stay close to 50.27 and 33.51 and the
+       result is still closed, so there are no boundary loops.
+       A face on a vertex missing from verts is kept with its payload.
+    */
+   std::cout << "\n\nTest 15. About 13107 faces, area 50.27, volume 33.51, "
+                "Yes." << std::endl;
+
+   Verts simpleVerts = verts;
+   Faces simpleFaces = faces;
+   Edges simpleEdges;
+   auto start = std::chrono::steady_clock::now();
+   auto collapses = Geom::simplify(simpleVerts, simpleFaces, simpleEdges,
+                                   faces.size() / 10, 1);
+   auto end = std::chrono::steady_clock::now();
+   Geom::measure(simpleVerts, simpleFaces, area, volume, centroid);
+   Topo::analyze(simpleFaces, boundaryEdges, nonManifoldEdges,
+                 flippedEdges, boundaryVerts, nonManifoldVerts, loops);
+
+   std::cout << "  Collapses: " << collapses << " in "
+             << std::chrono::duration<double, std::milli>(end - start).count()
+             << " ms" << std::endl;
+   std::cout << "  Faces:     " << simpleFaces.size() << std::endl;
+   std::cout << "  Area:      " << area << std::endl;
+   std::cout << "  Volume:    " << volume << std::endl;
+   std::cout << "  Loops:     " << loops.size() << ", "
+             << nonManifoldEdges.size() << std::endl;
+
+   int marker = 15;
+   Verts strayVerts = verts;
+   Faces strayFaces = faces;
+   strayFaces.insert(Face(0, 1, 70000), &marker);
+   Geom::simplify(strayVerts, strayFaces, faces.size() / 10, 1);
+
+   std::cout << "  Kept:      "
+             << (strayFaces[Face(0, 1, 70000)] == &marker ? "Yes" : "No")
+             << std::endl;
+
+
+   /* Test 16. Subdivision.
+       Subdividing the seeding octahedron 7 times with midpoints projected
+       onto the sphere gives back the octasphere of verts.txt and faces.txt
+       with the same counts, area and volume as test 12.
+       The same levels on flat arrays give the same vertices in order.
+       Loop subdivision of the same octahedron shrinks it instead.
+    */
+   std::cout << "\n\nTest 16. 65538 verts, 131072 faces, area 50.263."
+             << std::endl;
+
+   Verts sphereVerts, loopVerts;
+   Faces sphereFaces, loopFaces;
+   sphereVerts.insert(Vert(-2, 0, 0));
+   sphereVerts.insert(Vert(2, 0, 0));
+   sphereVerts.insert(Vert(0, -2, 0));
+   sphereVerts.insert(Vert(0, 2, 0));
+   sphereVerts.insert(Vert(0, 0, -2));
+   sphereVerts.insert(Vert(0, 0, 2));
+   sphereFaces.insert(Face(1, 3, 5), nullptr);
+   sphereFaces.insert(Face(3, 0, 5), nullptr);
+   sphereFaces.insert(Face(0, 2, 5), nullptr);
+   sphereFaces.insert(Face(2, 1, 5), nullptr);
+   sphereFaces.insert(Face(3, 1, 4), nullptr);
+   sphereFaces.insert(Face(0, 3, 4), nullptr);
+   sphereFaces.insert(Face(2, 0, 4), nullptr);
+   sphereFaces.insert(Face(1, 2, 4), nullptr);
+   loopVerts = sphereVerts;
+   loopFaces = sphereFaces;
+
+   std::vector<Vert> flatVerts(sphereVerts.size());
+   std::vector<Face> flatFaces(sphereFaces.size());
+   std::vector<void *> flatPtr(sphereFaces.size());
+   sphereVerts.copy_all(&flatVerts[0]);
+   sphereFaces.copy_all(&flatFaces[0], &flatPtr[0]);
+
+   start = std::chrono::steady_clock::now();
+   for (int i = 0; i != 7; i++)
+      Geom::subdivide(flatVerts, flatFaces, Vert(0, 0, 0));
+   end = std::chrono::steady_clock::now();
+   auto flatTime = std::chrono::duration<double, std::milli>(end - start);
+
+   start = std::chrono::steady_clock::now();
+   for (int i = 0; i != 7; i++)
+      Geom::subdivide(sphereVerts, sphereFaces, Vert(0, 0, 0));
+   end = std::chrono::steady_clock::now();
+
+   for (int i = 0; i != 3; i++)
+      Geom::loop(loopVerts, loopFaces);
+
+   Geom::measure(sphereVerts, sphereFaces, area, volume, centroid);
+   std::cout << "  Midpoint: " << sphereVerts.size() << ", "
+             << sphereFaces.size() << ", " << area << ", " << volume
+             << " in "
+             << std::chrono::duration<double, std::milli>(end - start).count()
+             << " ms" << std::endl;
+
+   std::vector<Vert> copiedVerts(sphereVerts.size());
+   sphereVerts.copy_all(&copiedVerts[0]);
+   std::cout << "  Flat:     " << flatVerts.size() << ", " << flatFaces.size()
+             << ", " << (flatVerts == copiedVerts ? "same" : "different")
+             << " in " << flatTime.count() << " ms" << std::endl;
+
+   Geom::measure(loopVerts, loopFaces, area, volume, centroid);
+   std::cout << "  Loop:     " << loopVerts.size() << ", "
+             << loopFaces.size() << ", " << area << ", " << volume
+             << std::endl;
+
+
+   /* Test 17. Smoothing.
+       10 Laplacian steps shrink the octasphere a little, whereas Taubin
+       smoothing keeps its volume close to 33.51.
+       With every vertex locked by a zero weight nothing moves.
+    */
+   std::cout << "\n\nTest 17. Laplacian shrinks, Taubin keeps 33.51."
+             << std::endl;
+
+   Verts smoothVerts = sphereVerts;
+   Geom::smooth(smoothVerts, sphereFaces, 10, 0.5, 0);
+   std::cout << "  Laplacian: " << Geom::volume(smoothVerts, sphereFaces)
+             << std::endl;
+
+   smoothVerts = sphereVerts;
+   Geom::smooth(smoothVerts, sphereFaces, 10, 0.5, -0.53);
+   std::cout << "  Taubin:    " << Geom::volume(smoothVerts, sphereFaces)
+             << std::endl;
+
+   smoothVerts = sphereVerts;
+   Geom::smooth(smoothVerts, sphereFaces, 10, 0.5, -0.53,
+                std::vector<double>(smoothVerts.size(), 0));
+   std::cout << "  Locked:    " << Geom::volume(smoothVerts, sphereFaces)
+             << std::endl;
+
+
+   /* Test 18. Bulk vertex updates.
+       Every vertex is scaled by 2 over 10 frames, once with single
+       modify calls and once with a deferred bulk modify per frame.
+       Both end up with the same coordinates and searching for the scaled
+       first vertex finds index 0 in both.
+       4 threads searching the deferred Verts at once after another bulk
+       modify all find index 0 as well, one of them rebuilding the index.
+    */
+   std::cout << "\n\nTest 18. All should find index 0 at (-4, 0, 0)."
+             << std::endl;
+
+   Verts singleVerts = sphereVerts, bulkVerts = sphereVerts;
+   vectorIdx.resize(sphereVerts.size());
+   vectorVerts.resize(sphereVerts.size());
+   sphereVerts.copy_all(&vectorIdx[0], &vectorVerts[0]);
+
+   start = std::chrono::steady_clock::now();
+
+   for (int frame = 1; frame <= 10; frame++)
+      for (std::size_t i = 0; i != vectorIdx.size(); i++)
+      {
+         auto scale = 1 + frame / 10.0;
+         singleVerts.modify(vectorIdx[i],
+                            Vert(vectorVerts[i].x * scale,
+                                 vectorVerts[i].y * scale,
+                                 vectorVerts[i].z * scale));
+      }
+
+   end = std::chrono::steady_clock::now();
+   std::cout << "  Single: "
+             << std::chrono::duration<double, std::milli>(end - start).count()
+             << " ms, " << *singleVerts.search(Vert(-4, 0, 0)).begin()
+             << std::endl;
+
+   std::vector<Vert> frameVerts(vectorVerts.size());
+   start = std::chrono::steady_clock::now();
+   bulkVerts.defer(true);
+
+   for (int frame = 1; frame <= 10; frame++)
+   {
+      for (std::size_t i = 0; i != vectorIdx.size(); i++)
+      {
+         auto scale = 1 + frame / 10.0;
+         frameVerts[i] = Vert(vectorVerts[i].x * scale,
+                              vectorVerts[i].y * scale,
+                              vectorVerts[i].z * scale);
+      }
+
+      bulkVerts.modify(&vectorIdx[0], &frameVerts[0], vectorIdx.size());
+   }
+
+   end = std::chrono::steady_clock::now();
+   std::cout << "  Bulk:   "
+             << std::chrono::duration<double, std::milli>(end - start).count()
+             << " ms, " << *bulkVerts.search(Vert(-4, 0, 0)).begin()
+             << std::endl;
+
+   bulkVerts.modify(&vectorIdx[0], &frameVerts[0], vectorIdx.size());
+   std::vector<std::size_t> shared(4, -1);
+   std::vector<std::thread> readers;
+
+   for (std::size_t i = 0; i != shared.size(); i++)
+      readers.push_back(std::thread([&, i]() {
+         shared[i] = *bulkVerts.search(Vert(-4, 0, 0)).begin();
+      }));
+
+   for (std::size_t i = 0; i != readers.size(); i++)
+      readers[i].join();
+
+   std::cout << "  Shared:";
+
+   for (std::size_t i = 0; i != shared.size(); i++)
+      std::cout << " " << shared[i];
+
+   std::cout << std::endl;
+   bulkVerts.defer(false);
+
+
+   /* Test 19. Deferred face indexes.
+       All faces are inserted once with every index kept in sync and once
+       with the secondary indexes deferred until the first search.
+       Both give the 6 faces around vertex 56691 of the subdivided sphere.
+       4 threads searching the still deferred Faces at once after another
+       write find 6 faces around each of 56691 to 56694.
+    */
+   std::cout << "\n\nTest 19. All should find 6 faces." << std::endl;
+
+   Faces eagerFaces, lazyFaces;
+   vectorFaces.resize(sphereFaces.size());
+   vectorPtr.resize(sphereFaces.size());
+   sphereFaces.copy_all(&vectorFaces[0], &vectorPtr[0]);
+
+   start = std::chrono::steady_clock::now();
+
+   for (std::size_t i = 0; i != vectorFaces.size(); i++)
+      eagerFaces.insert(vectorFaces[i], nullptr);
+
+   auto eager = eagerFaces.search(56691).size();
+   end = std::chrono::steady_clock::now();
+   std::cout << "  Eager:    "
+             << std::chrono::duration<double, std::milli>(end - start).count()
+             << " ms, " << eager << std::endl;
+
+   start = std::chrono::steady_clock::now();
+   lazyFaces.defer(true);
+
+   for (std::size_t i = 0; i != vectorFaces.size(); i++)
+      lazyFaces.insert(vectorFaces[i], nullptr);
+
+   auto lazy = lazyFaces.search(56691).size();
+   end = std::chrono::steady_clock::now();
+   std::cout << "  Deferred: "
+             << std::chrono::duration<double, std::milli>(end - start).count()
+             << " ms, " << lazy << std::endl;
+
+   lazyFaces.insert(vectorFaces[0], nullptr);
+   std::vector<std::size_t> rings(4, 0);
+   readers.clear();
+
+   for (std::size_t i = 0; i != rings.size(); i++)
+      readers.push_back(std::thread([&, i]() {
+         rings[i] = lazyFaces.search(56691 + i).size();
+      }));
+
+   for (std::size_t i = 0; i != readers.size(); i++)
+      readers[i].join();
+
+   std::cout << "  Shared:  ";
+
+   for (std::size_t i = 0; i != rings.size(); i++)
+      std::cout << " " << rings[i];
+
+   std::cout << std::endl;
+
+
+   /* Test 20. Batched lookups.
+       Every edge of the subdivided sphere is looked up reversed together
+       with as many edges that do not exist, shuffled, first one call at a
+       time and then in one batch. Half of the probes should be found
+       either way.
+       A batched search for every vertex coordinate returns its own index.
+    */
+   std::cout << "\n\nTest 20. Half found both ways, all indices match."
+             << std::endl;
+
+   Edges sphereEdges;
+   sphereFaces.sync(sphereEdges);
+   std::vector<Edge> probes(sphereEdges.size());
+   sphereEdges.copy_all(&probes[0]);
+
+   for (std::size_t i = 0, size = probes.size(); i != size; i++)
+   {
+      std::swap(probes[i].v1, probes[i].v2);
+      probes.push_back(Edge(probes[i].v2, probes[i].v1 + 100000));
+   }
+
+   std::shuffle(probes.begin(), probes.end(), std::mt19937(1));
+
+   std::size_t found = 0;
+   start = std::chrono::steady_clock::now();
+
+   for (std::size_t i = 0; i != probes.size(); i++)
+      found += sphereEdges.find(probes[i]);
+
+   end = std::chrono::steady_clock::now();
+   std::cout << "  Single:  "
+             << std::chrono::duration<double, std::milli>(end - start).count()
+             << " ms, " << found << " of " << probes.size() << std::endl;
+
+   std::unique_ptr<bool[]> results(new bool[probes.size()]);
+   found = 0;
+   start = std::chrono::steady_clock::now();
+   sphereEdges.find(&probes[0], probes.size(), results.get());
+   end = std::chrono::steady_clock::now();
+
+   for (std::size_t i = 0; i != probes.size(); i++)
+      found += results[i];
+
+   std::cout << "  Batch:   "
+             << std::chrono::duration<double, std::milli>(end - start).count()
+             << " ms, " << found << " of " << probes.size() << std::endl;
+
+   std::vector<std::size_t> searched(vectorVerts.size());
+   sphereVerts.search(&vectorVerts[0], vectorVerts.size(), &searched[0]);
+   std::cout << "  Indices: " << (searched == vectorIdx ? "Yes" : "No")
+             << std::endl;
+
+
+   /* Test 21. Streaming with a 1 MB memory budget.
+       The boundary of faces1 has 6 + 6 + 4 * 4 + 3 * 3 = 37 edges.
+       Every face of the octasphere gets a normal.
+       A triangle soup with 3 own vertices per face welds back into
+       65538 vertices and 131072 faces, also with a 16 KB budget that
+       spills thousands of runs and merges them in several passes.
+    */
+   std::cout << "\n\nTest 21. 37 edges, 131072 normals, 65538 and 131072."
+             << std::endl;
+
+   bool streamed = true;
+   File::write_faces(faces1, "output_faces.txt");
+   streamed = File::stream_boundary("output_faces.txt", "output_boundary.txt",
+                                    1 << 20) && streamed;
+   std::cout << "  Boundary: " << lines("output_boundary.txt") << std::endl;
+
+   streamed = File::stream_normals("verts.txt", "faces.txt",
+                                   "output_normals.txt", 1 << 20) && streamed;
+   std::cout << "  Normals:  " << lines("output_normals.txt") << std::endl;
+
+   std::ofstream soupVerts("output_soup_verts.txt");
+   std::ofstream soupFaces("output_soup_faces.txt");
+   vectorVerts.resize(sphereVerts.size());
+   vectorFaces.resize(sphereFaces.size());
+   vectorPtr.resize(sphereFaces.size());
+   sphereVerts.copy_all(&vectorVerts[0]);
+   sphereFaces.copy_all(&vectorFaces[0], &vectorPtr[0]);
+
+   for (std::size_t i = 0; i != vectorFaces.size(); i++)
+   {
+      std::size_t corners[3] = {vectorFaces[i].v1, vectorFaces[i].v2,
+                                vectorFaces[i].v3};
+
+      for (int j = 0; j != 3; j++)
+         soupVerts << std::setprecision(17) << vectorVerts[corners[j]].x
+                   << "," << vectorVerts[corners[j]].y << ","
+                   << vectorVerts[corners[j]].z << "\n";
+
+      soupFaces << 3 * i << "," << 3 * i + 1 << "," << 3 * i + 2 << "\n";
+   }
+
+   soupVerts.close();
+   soupFaces.close();
+   streamed = File::stream_weld("output_soup_verts.txt",
+                                "output_soup_faces.txt",
+                                "output_weld_verts.txt",
+                                "output_weld_faces.txt", 1 << 20) && streamed;
+   std::cout << "  Welded:   " << lines("output_weld_verts.txt") << ", "
+             << lines("output_weld_faces.txt") << std::endl;
+
+   streamed = File::stream_weld("output_soup_verts.txt",
+                                "output_soup_faces.txt",
+                                "output_small_verts.txt",
+                                "output_small_faces.txt", 1 << 14) && streamed;
+   std::ifstream weldFaces("output_weld_faces.txt");
+   std::ifstream smallFaces("output_small_faces.txt");
+   std::string weldLine, smallLine;
+   bool welded = lines("output_weld_verts.txt") ==
+               lines("output_small_verts.txt");
+
+   while (std::getline(weldFaces, weldLine))
+      welded = std::getline(smallFaces, smallLine) && smallLine == weldLine &&
+             welded;
+
+   welded = !std::getline(smallFaces, smallLine) && welded;
+   std::cout << "  Small:    " << welded << ", streamed " << streamed
+             << std::endl;
+
+
+   /* Test 22. Shared-memory snapshot of the octasphere.
+       A second Snapshot attaches to the published segment read-only and
+       answers the same queries as the trees it was built from.
+       Publishing verts and faces1 under the same name leaves the attached
+       segment whole, and a new reader sees the new sizes.
+    */
+   std::cout << "\n\nTest 22. 65538, 196608, 131072, Yes, Yes, Yes, Yes."
+             << std::endl;
+
+   Snapshot publisher, reader;
+   Snapshot::unlink("/mesh_test");
+   start = std::chrono::steady_clock::now();
+   auto published = publisher.publish("/mesh_test", sphereVerts, sphereEdges,
+                                      sphereFaces);
+   end = std::chrono::steady_clock::now();
+   std::cout << "  Publish: "
+             << std::chrono::duration<double, std::milli>(end - start).count()
+             << " ms" << std::endl;
+
+   if (published && reader.attach("/mesh_test"))
+   {
+      std::cout << "  Sizes:   " << reader.size_verts() << ", "
+                << reader.size_edges() << ", " << reader.size_faces()
+                << std::endl;
+
+      auto same = true;
+
+      for (std::size_t i = 0; i != vectorVerts.size() && same; i++)
+         same = reader[i] == vectorVerts[i] &&
+                reader.search(vectorVerts[i]) ==
+                   sphereVerts.search(vectorVerts[i]);
+
+      std::cout << "  Verts:   " << (same ? "Yes" : "No") << std::endl;
+
+      same = true;
+
+      for (std::size_t i = 0; i != vectorFaces.size() && same; i++)
+      {
+         auto around = sphereFaces.search(vectorFaces[i].v1);
+         auto shared = reader.search_faces(vectorFaces[i].v1);
+
+         same = reader.find(Face(vectorFaces[i].v3, vectorFaces[i].v1,
+                                 vectorFaces[i].v2)) &&
+                reader.find(Edge(vectorFaces[i].v2, vectorFaces[i].v1)) &&
+                reader.search_edges(vectorFaces[i].v2) ==
+                   sphereEdges.search(vectorFaces[i].v2) &&
+                shared.size() == around.size();
+
+         for (auto lower = around.begin(), upper = around.end();
+              lower != upper && same; lower++)
+            same = shared.count(lower->first) != 0;
+      }
+
+      std::cout << "  Faces:   " << (same ? "Yes" : "No") << std::endl;
+      std::cout << "  Absent:  "
+                << (!reader.find(Face(0, 1, 2)) && !reader.find(Edge(0, 0))
+                       ? "Yes" : "No")
+                << std::endl;
+
+      Snapshot republisher, second;
+      same = republisher.publish("/mesh_test", verts, Edges(), faces1) &&
+             second.attach("/mesh_test") &&
+             second.size_verts() == verts.size() &&
+             second.size_faces() == faces1.size() &&
+             reader.size_verts() == vectorVerts.size() &&
+             reader[vectorVerts.size() - 1] == vectorVerts.back() &&
+             reader.find(vectorFaces.back());
+      std::cout << "  Renewed: " << (same ? "Yes" : "No") << std::endl;
+   }
+   else
+      std::cout << "  Shared memory is not available." << std::endl;
+
+   reader.detach();
+   publisher.detach();
+   Snapshot::unlink("/mesh_test");
+
+
+   /* Test 23. Order-independent fingerprints.
+       Faces inserted in shuffled order with deferred indexes, and the
+       edges synced from them, end up with the same fingerprints as the
+       originals. Erasing a face changes the fingerprint, and inserting
+       it again restores it. The same holds for moving a vertex away and
+       back, and a dense compaction changes nothing.
+    */
+   std::cout << "\n\nTest 23. Yes, Yes, No, Yes, No, Yes, Yes." << std::endl;
+
+   Faces shuffledFaces;
+   Edges shuffledEdges;
+   std::vector<std::size_t> order(vectorFaces.size());
+
+   for (std::size_t i = 0; i != order.size(); i++)
+      order[i] = i;
+
+   std::shuffle(order.begin(), order.end(), std::mt19937(2));
+   shuffledFaces.defer(true);
+
+   for (std::size_t i = 0; i != order.size(); i++)
+      shuffledFaces.insert(Face(vectorFaces[order[i]].v2,
+                                vectorFaces[order[i]].v3,
+                                vectorFaces[order[i]].v1),
+                           nullptr);
+
+   shuffledFaces.defer(false);
+   shuffledFaces.sync(shuffledEdges);
+
+   std::cout << "  Faces:   "
+             << (shuffledFaces.fingerprint() == sphereFaces.fingerprint()
+                    ? "Yes" : "No")
+             << std::endl;
+   std::cout << "  Edges:   "
+             << (shuffledEdges.fingerprint() == sphereEdges.fingerprint()
+                    ? "Yes" : "No")
+             << std::endl;
+
+   shuffledFaces.erase(vectorFaces[0]);
+   std::cout << "  Erased:  "
+             << (shuffledFaces.fingerprint() == sphereFaces.fingerprint()
+                    ? "Yes" : "No")
+             << std::endl;
+
+   shuffledFaces.insert(vectorFaces[0], nullptr);
+   std::cout << "  Back:    "
+             << (shuffledFaces.fingerprint() == sphereFaces.fingerprint()
+                    ? "Yes" : "No")
+             << std::endl;
+
+   Verts movedVerts = sphereVerts;
+   movedVerts.modify(7, Vert(0, 0, 0));
+   std::cout << "  Moved:   "
+             << (movedVerts.fingerprint() == sphereVerts.fingerprint()
+                    ? "Yes" : "No")
+             << std::endl;
+
+   movedVerts.modify(7, vectorVerts[7]);
+   std::cout << "  Restore: "
+             << (movedVerts.fingerprint() == sphereVerts.fingerprint()
+                    ? "Yes" : "No")
+             << std::endl;
+
+   movedVerts.compact();
+   std::cout << "  Compact: "
+             << (movedVerts.fingerprint() == sphereVerts.fingerprint()
+                    ? "Yes" : "No")
+             << std::endl;
+
+
+   /* Test 24. Dual graph cache.
+       The cached neighbors of every octasphere face match the ones found
+       through Faces::search(const Edge &), and the cache answers faster.
+       After erasing by vertex, edge and face and inserting the faces back,
+       the incrementally kept cache equals one built from scratch.
+       4 threads asking a deferred copy for the neighbors of a quarter of
+       the faces each, while its cache still has to be rebuilt, match too.
+       faces1 has 37 boundary edges, so 37 slots hold the sentinel.
+    */
+   std::cout << "\n\nTest 24. Yes, Yes, Yes, 37." << std::endl;
+
+   Faces linkedFaces = sphereFaces;
+   linkedFaces.adjacency(true);
+
+   std::vector<Face> slots(3 * vectorFaces.size());
+   start = std::chrono::steady_clock::now();
+
+   for (std::size_t i = 0; i != vectorFaces.size(); i++)
+   {
+      std::size_t corners[3] = {vectorFaces[i].v1, vectorFaces[i].v2,
+                                vectorFaces[i].v3};
+
+      for (std::size_t j = 0; j != 3; j++)
+      {
+         auto shared = sphereFaces.search(Edge(corners[j],
+                                               corners[(j + 1) % 3]));
+         slots[3 * i + j] = Face(-1, -1, -1);
+
+         for (auto lower = shared.begin(), upper = shared.end();
+              lower != upper; lower++)
+            if (!(lower->first == vectorFaces[i]))
+               slots[3 * i + j] = lower->first;
+      }
+   }
+
+   end = std::chrono::steady_clock::now();
+   std::cout << "  Search:  "
+             << std::chrono::duration<double, std::milli>(end - start).count()
+             << " ms" << std::endl;
+
+   auto same = true;
+   Face around[3];
+   start = std::chrono::steady_clock::now();
+
+   for (std::size_t i = 0; i != vectorFaces.size(); i++)
+   {
+      linkedFaces.neighbors(vectorFaces[i], around);
+
+      for (std::size_t j = 0; j != 3; j++)
+         same = same && around[j] == slots[3 * i + j];
+   }
+
+   end = std::chrono::steady_clock::now();
+   std::cout << "  Cached:  "
+             << std::chrono::duration<double, std::milli>(end - start).count()
+             << " ms" << std::endl;
+   std::cout << "  Match:   " << (same ? "Yes" : "No") << std::endl;
+
+   Faces staleFaces = sphereFaces;
+   staleFaces.adjacency(true);
+   staleFaces.defer(true);
+   staleFaces.insert(vectorFaces[0], nullptr);
+   std::vector<char> matches(4, 1);
+   readers.clear();
+
+   for (std::size_t t = 0; t != matches.size(); t++)
+      readers.push_back(std::thread([&, t]() {
+         Face found[3];
+
+         for (auto i = t; i < vectorFaces.size(); i += matches.size())
+         {
+            staleFaces.neighbors(vectorFaces[i], found);
+
+            for (std::size_t j = 0; j != 3; j++)
+               if (!(found[j] == slots[3 * i + j]))
+                  matches[t] = 0;
+         }
+      }));
+
+   for (std::size_t i = 0; i != readers.size(); i++)
+      readers[i].join();
+
+   std::cout << "  Shared:  "
+             << (std::count(matches.begin(), matches.end(), 1) == 4 ? "Yes"
+                                                                   : "No")
+             << std::endl;
+
+   auto removed = linkedFaces.search(vectorFaces[100].v1);
+   auto removedEdge = linkedFaces.search(Edge(vectorFaces[5000].v1,
+                                              vectorFaces[5000].v2));
+   linkedFaces.erase(vectorFaces[100].v1);
+   linkedFaces.erase(Edge(vectorFaces[5000].v1, vectorFaces[5000].v2));
+   linkedFaces.erase(vectorFaces[9000]);
+   linkedFaces.insert(vectorFaces[9000], nullptr);
+   removed.insert(removedEdge.begin(), removedEdge.end());
+
+   for (auto lower = removed.begin(), upper = removed.end(); lower != upper;
+        lower++)
+      linkedFaces.insert(lower->first, nullptr);
+
+   Faces rebuiltFaces = linkedFaces;
+   rebuiltFaces.adjacency(false);
+   rebuiltFaces.adjacency(true);
+   same = linkedFaces.size() == sphereFaces.size();
+   Face rebuilt[3];
+
+   for (std::size_t i = 0; i != vectorFaces.size(); i++)
+   {
+      linkedFaces.neighbors(vectorFaces[i], around);
+      rebuiltFaces.neighbors(vectorFaces[i], rebuilt);
+
+      for (std::size_t j = 0; j != 3; j++)
+         same = same && around[j] == rebuilt[j] &&
+                around[j] == slots[3 * i + j];
+   }
+
+   std::cout << "  Kept:    " << (same ? "Yes" : "No") << std::endl;
+
+   vectorFaces.resize(faces1.size());
+   vectorPtr.resize(faces1.size());
+   faces1.copy_all(&vectorFaces[0], &vectorPtr[0]);
+   faces1.adjacency(true);
+   std::size_t open = 0;
+
+   for (std::size_t i = 0; i != vectorFaces.size(); i++)
+   {
+      faces1.neighbors(vectorFaces[i], around);
+
+      for (std::size_t j = 0; j != 3; j++)
+         open += around[j] == Face(-1, -1, -1);
+   }
+
+   faces1.adjacency(false);
+   std::cout << "  Open:    " << open << std::endl;
+
+
+   /* Test 25. Self-intersections.
+       The octasphere is clean. In a small mesh a triangle pierces the
+       first one, a coplanar triangle lies inside it, a third shares an
+       edge with it and a fourth is far away, so only the first 2 pairs
+       count. Pulling a pole of the octasphere through the opposite pole
+       makes the faces around it cross the other side. A triangle far
+       larger than the grid cells, in the plane z = 0.01, crosses exactly
+       the faces of the octasphere that straddle that plane.
+    */
+   std::cout << "\n\nTest 25. 0, (0,1,2)-(3,4,5) (0,1,2)-(6,7,8), Yes, Yes."
+             << std::endl;
+
+   start = std::chrono::steady_clock::now();
+   auto crossed = Geom::intersect(sphereVerts, sphereFaces);
+   end = std::chrono::steady_clock::now();
+   std::cout << "  Sphere:  " << crossed.size() << " in "
+             << std::chrono::duration<double, std::milli>(end - start).count()
+             << " ms" << std::endl;
+
+   Verts pieceVerts;
+   Faces pieceFaces;
+   double coords[][3] = {{0, 0, 0},      {1, 0, 0},      {0, 1, 0},
+                         {0.2, 0.2, -1},  {0.2, 0.2, 1},  {0.3, 0.2, 0},
+                         {0.4, 0.3, 0},   {0.6, 0.3, 0},  {0.4, 0.5, 0},
+                         {1, 1, 1},       {5, 5, 5},      {6, 5, 5},
+                         {5, 6, 5}};
+
+   for (std::size_t i = 0; i != 13; i++)
+      pieceVerts.insert(Vert(coords[i][0], coords[i][1], coords[i][2]));
+
+   pieceFaces.insert(Face(0, 1, 2), nullptr);
+   pieceFaces.insert(Face(3, 4, 5), nullptr);
+   pieceFaces.insert(Face(6, 7, 8), nullptr);
+   pieceFaces.insert(Face(1, 9, 2), nullptr);
+   pieceFaces.insert(Face(10, 11, 12), nullptr);
+   crossed = Geom::intersect(pieceVerts, pieceFaces);
+   std::cout << "  Pieces: ";
+
+   for (std::size_t i = 0; i != crossed.size(); i++)
+      std::cout << " (" << crossed[i].first.v1 << "," << crossed[i].first.v2
+                << "," << crossed[i].first.v3 << ")-(" << crossed[i].second.v1
+                << "," << crossed[i].second.v2 << ","
+                << crossed[i].second.v3 << ")";
+
+   std::cout << std::endl;
+
+   Verts pulledVerts = sphereVerts;
+   auto poles = sphereVerts.search(Vert(0, 0, 2));
+
+   if (!poles.empty())
+      pulledVerts.modify(*poles.begin(), Vert(0, 0, -3));
+
+   crossed = Geom::intersect(pulledVerts, sphereFaces);
+   std::cout << "  Pulled:  " << (crossed.empty() ? "No" : "Yes")
+             << std::endl;
+
+   Verts slicedVerts = sphereVerts;
+   Faces slicedFaces = sphereFaces;
+   auto sphereSize = sphereVerts.size();
+   std::size_t straddling = 0;
+   vectorVerts.resize(sphereSize);
+   vectorFaces.resize(sphereFaces.size());
+   vectorPtr.resize(sphereFaces.size());
+   sphereVerts.copy_all(&vectorVerts[0]);
+   sphereFaces.copy_all(&vectorFaces[0], &vectorPtr[0]);
+
+   for (std::size_t i = 0; i != vectorFaces.size(); i++)
+   {
+      auto z1 = vectorVerts[vectorFaces[i].v1].z;
+      auto z2 = vectorVerts[vectorFaces[i].v2].z;
+      auto z3 = vectorVerts[vectorFaces[i].v3].z;
+      straddling += std::min(z1, std::min(z2, z3)) < 0.01 &&
+                    std::max(z1, std::max(z2, z3)) > 0.01;
+   }
+
+   slicedVerts.insert(Vert(-10, -10, 0.01));
+   slicedVerts.insert(Vert(10, -10, 0.01));
+   slicedVerts.insert(Vert(0, 10, 0.01));
+   slicedFaces.insert(Face(sphereSize, sphereSize + 1, sphereSize + 2),
+                      nullptr);
+   start = std::chrono::steady_clock::now();
+   crossed = Geom::intersect(slicedVerts, slicedFaces);
+   end = std::chrono::steady_clock::now();
+   std::cout << "  Sliced:  "
+             << (straddling != 0 && crossed.size() == straddling ? "Yes"
+                                                                 : "No")
+             << " in "
+             << std::chrono::duration<double, std::milli>(end - start).count()
+             << " ms" << std::endl;
+
+
+   /* Test 26. Geodesic distances on the octasphere of radius 2.
+       The octasphere has vertices along its meridians, so Dijkstra finds
+       the south pole 2 * pi = 6.283 away from the north pole, less the
+       little lost to the chords. Fast marching cuts across the faces and
+       comes out slightly shorter. Dijkstra gives the same field as a
+       search through Edges and Verts. Batched source sets match single
+       runs, and seeding both poles gives the smaller of the two
+       distances everywhere.
+    */
+   std::cout << "\n\nTest 26. 6.283 then below, Yes, Yes, Yes." << std::endl;
+
+   auto north = *sphereVerts.search(Vert(0, 0, 2)).begin();
+   auto south = *sphereVerts.search(Vert(0, 0, -2)).begin();
+   auto INF = std::numeric_limits<double>::infinity();
+   std::vector<double> walked(sphereVerts.size(), INF);
+   std::priority_queue<std::pair<double, std::size_t>,
+                       std::vector<std::pair<double, std::size_t>>,
+                       std::greater<std::pair<double, std::size_t>>> queue;
+
+   start = std::chrono::steady_clock::now();
+   walked[north] = 0;
+   queue.push(std::pair<double, std::size_t>(0, north));
+
+   while (!queue.empty())
+   {
+      auto top = queue.top();
+      queue.pop();
+
+      if (top.first > walked[top.second])
+         continue;
+
+      auto around = sphereEdges.search(top.second);
+      auto from = sphereVerts[top.second];
+
+      for (auto lower = around.begin(), upper = around.end(); lower != upper;
+           lower++)
+      {
+         auto other = lower->v1 == top.second ? lower->v2 : lower->v1;
+         auto to = sphereVerts[other];
+         auto next = top.first + std::sqrt((to.x - from.x) * (to.x - from.x) +
+                                           (to.y - from.y) * (to.y - from.y) +
+                                           (to.z - from.z) * (to.z - from.z));
+
+         if (next < walked[other])
+         {
+            walked[other] = next;
+            queue.push(std::pair<double, std::size_t>(next, other));
+         }
+      }
+   }
+
+   end = std::chrono::steady_clock::now();
+   std::cout << "  Search:   "
+             << std::chrono::duration<double, std::milli>(end - start).count()
+             << " ms" << std::endl;
+
+   start = std::chrono::steady_clock::now();
+   auto graph = Geom::geodesic(sphereVerts, sphereFaces,
+                               std::vector<std::size_t>(1, north), false);
+   end = std::chrono::steady_clock::now();
+   std::cout << "  Dijkstra: "
+             << std::chrono::duration<double, std::milli>(end - start).count()
+             << " ms" << std::endl;
+
+   start = std::chrono::steady_clock::now();
+   auto marched = Geom::geodesic(sphereVerts, sphereFaces,
+                                 std::vector<std::size_t>(1, north), true);
+   end = std::chrono::steady_clock::now();
+   std::cout << "  Marching: "
+             << std::chrono::duration<double, std::milli>(end - start).count()
+             << " ms" << std::endl;
+
+   std::cout << std::setprecision(4) << "  South:    " << graph[south]
+             << ", " << marched[south] << std::setprecision(6) << std::endl;
+   std::cout << "  Same:     " << (graph == walked ? "Yes" : "No")
+             << std::endl;
+
+   std::vector<std::vector<std::size_t>> sources(3);
+   sources[0].push_back(north);
+   sources[1].push_back(south);
+   sources[2].push_back(north);
+   sources[2].push_back(south);
+   auto fields = Geom::geodesic(sphereVerts, sphereFaces, sources, false);
+   std::cout << "  Batch:    "
+             << (fields[0] == graph &&
+                 Geom::geodesic(sphereVerts, sphereFaces, sources, true)[0] ==
+                    marched
+                    ? "Yes" : "No")
+             << std::endl;
+
+   same = true;
+
+   for (std::size_t i = 0; i != fields[2].size(); i++)
+      same = same && fields[2][i] == std::min(fields[0][i], fields[1][i]);
+
+   std::cout << "  Nearest:  " << (same ? "Yes" : "No") << std::endl;
+
+
+   /* Test 27. Exchange formats.
+       The octasphere goes out as binary PLY, OBJ and binary STL and
+       comes back in. PLY keeps doubles and OBJ prints 17 digits, so both
+       give back the very same vertices and faces. STL stores one float
+       triangle after another and welding the corners brings back
+       65538 vertices and 131072 faces, also with padding after the last
+       triangle, into containers that stay deferred. OBJ and PLY faces
+       with index 0, negative or past the last vertex are refused.
+    */
+   std::cout << "\n\nTest 27. Yes, Yes, 65538 and 131072, Yes, 65538 and "
+             << "131072, Yes." << std::endl;
+
+   Verts importedVerts;
+   Faces importedFaces;
+   const char *formats[] = {"PLY", "OBJ", "STL"};
+
+   for (int i = 0; i != 3; i++)
+   {
+      std::string filename = std::string("output_sphere.") + formats[i];
+      bool (*write)(const Verts &, const Faces &, const std::string &) =
+         i == 0 ? File::write_ply : i == 1 ? File::write_obj : File::write_stl;
+      bool (*read)(const std::string &, Verts &, Faces &) =
+         i == 0 ? File::read_ply : i == 1 ? File::read_obj : File::read_stl;
+
+      write(sphereVerts, sphereFaces, filename);
+      start = std::chrono::steady_clock::now();
+      auto loaded = read(filename, importedVerts, importedFaces);
+      end = std::chrono::steady_clock::now();
+      std::cout << "  " << formats[i] << ":     "
+                << std::chrono::duration<double, std::milli>(end - start).count()
+                << " ms" << std::endl;
+
+      if (i != 2)
+         std::cout << "  Same:    "
+                   << (loaded &&
+                       importedVerts.fingerprint() ==
+                          sphereVerts.fingerprint() &&
+                       importedFaces.fingerprint() == sphereFaces.fingerprint()
+                          ? "Yes" : "No")
+                   << std::endl;
+      else
+         std::cout << "  Welded:  " << importedVerts.size() << ", "
+                   << importedFaces.size() << std::endl;
+   }
+
+   auto save = [](const std::string &filename, const std::string &text) {
+      std::ofstream fout(filename.c_str(), std::ios::binary);
+      fout << text;
+   };
+   auto ply = [](int v3) {
+      std::string text = "ply\nformat binary_little_endian 1.0\n"
+                         "element vertex 3\nproperty double x\n"
+                         "property double y\nproperty double z\n"
+                         "element face 1\n"
+                         "property list uchar int vertex_indices\n"
+                         "end_header\n";
+      text.append(3 * 3 * sizeof(double), '\0');
+      text += char(3);
+      int corners[3] = {0, 1, v3};
+
+      for (int i = 0; i != 3; i++)
+         for (int j = 0; j != 4; j++)
+            text += char(unsigned(corners[i]) >> (8 * j) & 0xff);
+
+      return text;
+   };
+   std::string triangle = "v 0 0 0\nv 1 0 0\nv 0 1 0\n";
+   auto refused = true;
+
+   save("output_broken.obj", triangle + "f 1 2 0\n");
+   refused = !File::read_obj("output_broken.obj", importedVerts,
+                             importedFaces) && refused;
+   save("output_broken.obj", triangle + "f 1 2 4\n");
+   refused = !File::read_obj("output_broken.obj", importedVerts,
+                             importedFaces) && refused;
+   save("output_broken.obj", triangle + "f -1 -2 -4\n");
+   refused = !File::read_obj("output_broken.obj", importedVerts,
+                             importedFaces) && refused;
+   save("output_broken.obj", triangle + "f -1 -2 -3\n");
+   refused = File::read_obj("output_broken.obj", importedVerts,
+                            importedFaces) &&
+             importedFaces.size() == 1 && refused;
+   save("output_broken.ply", ply(-1));
+   refused = !File::read_ply("output_broken.ply", importedVerts,
+                             importedFaces) && refused;
+   save("output_broken.ply", ply(3));
+   refused = !File::read_ply("output_broken.ply", importedVerts,
+                             importedFaces) && refused;
+   save("output_broken.ply", ply(2));
+   refused = File::read_ply("output_broken.ply", importedVerts,
+                            importedFaces) &&
+             importedFaces.size() == 1 && refused;
+   std::cout << "  Refused: " << (refused ? "Yes" : "No") << std::endl;
+
+   std::ofstream("output_sphere.STL", std::ios::binary | std::ios::app)
+      << std::string(10, '\0');
+   importedVerts.defer(true);
+   importedFaces.defer(true);
+   File::read_stl("output_sphere.STL", importedVerts, importedFaces);
+   std::cout << "  Padded:  " << importedVerts.size() << ", "
+             << importedFaces.size() << std::endl;
+   std::cout << "  Kept:    "
+             << (importedVerts.defer() && importedFaces.defer() &&
+                 importedVerts.verify() && importedFaces.verify()
+                    ? "Yes" : "No")
+             << std::endl;
+   importedVerts.defer(false);
+   importedFaces.defer(false);
+
+
+   /* Test 28. Packed topology.
+       The octasphere faces and edges are packed into delta coded blocks
+       that take a small fraction of the trees. Every vertex finds the
+       same faces and edges as before, every face and edge is found and
+       unpacking gives back the same fingerprints. Faces of faces1 given
+       payloads get them back after a round trip.
+    */
+   std::cout << "\n\nTest 28. Smaller, Yes, Yes, Yes, Yes." << std::endl;
+
+   PackedFaces packedFaces;
+   PackedEdges packedEdges;
+   start = std::chrono::steady_clock::now();
+   packedFaces.pack(sphereFaces);
+   packedEdges.pack(sphereEdges);
+   end = std::chrono::steady_clock::now();
+   std::cout << "  Pack:    "
+             << std::chrono::duration<double, std::milli>(end - start).count()
+             << " ms" << std::endl;
+
+   auto bytes = [](const std::map<std::string, std::size_t> &map) {
+      std::size_t sum = 0;
+
+      for (auto iter = map.cbegin(); iter != map.cend(); iter++)
+         sum += iter->second;
+
+      return sum;
+   };
+
+   std::cout << "  Faces:   " << bytes(sphereFaces.memory()) << " to "
+             << bytes(packedFaces.memory()) << " bytes" << std::endl;
+   std::cout << "  Edges:   " << bytes(sphereEdges.memory()) << " to "
+             << bytes(packedEdges.memory()) << " bytes" << std::endl;
+
+   same = true;
+
+   for (std::size_t i = 0; i != sphereVerts.size() && same; i++)
+   {
+      auto around = sphereFaces.search(i);
+      auto packed = packedFaces.search(i);
+      same = around.size() == packed.size() &&
+             packedEdges.search(i) == sphereEdges.search(i);
+
+      for (auto lower = around.begin(), upper = around.end();
+           lower != upper && same; lower++)
+         same = packed.count(lower->first) != 0;
+   }
+
+   std::cout << "  Search:  " << (same ? "Yes" : "No") << std::endl;
+
+   vectorFaces.resize(sphereFaces.size());
+   vectorPtr.resize(sphereFaces.size());
+   sphereFaces.copy_all(&vectorFaces[0], &vectorPtr[0]);
+   same = !packedFaces.find(Face(0, 1, 2)) && !packedEdges.find(Edge(0, 0));
+
+   for (std::size_t i = 0; i != vectorFaces.size() && same; i++)
+      same = packedFaces.find(Face(vectorFaces[i].v2, vectorFaces[i].v3,
+                                   vectorFaces[i].v1)) &&
+             packedEdges.find(Edge(vectorFaces[i].v3, vectorFaces[i].v1));
+
+   std::cout << "  Find:    " << (same ? "Yes" : "No") << std::endl;
+
+   Faces unpackedFaces;
+   Edges unpackedEdges;
+   start = std::chrono::steady_clock::now();
+   packedFaces.unpack(unpackedFaces);
+   packedEdges.unpack(unpackedEdges);
+   end = std::chrono::steady_clock::now();
+   std::cout << "  Unpack:  "
+             << std::chrono::duration<double, std::milli>(end - start).count()
+             << " ms, "
+             << (unpackedFaces.fingerprint() == sphereFaces.fingerprint() &&
+                 unpackedEdges.fingerprint() == sphereEdges.fingerprint()
+                    ? "Yes" : "No")
+             << std::endl;
+
+   std::vector<Face> payloadFaces(faces1.size());
+   std::vector<void *> payloadPtr(faces1.size());
+   std::vector<int> payloads(faces1.size());
+   Faces carriedFaces;
+   faces1.copy_all(&payloadFaces[0], &payloadPtr[0]);
+
+   for (std::size_t i = 0; i != payloadFaces.size(); i++)
+      carriedFaces.insert(payloadFaces[i], i % 2 ? &payloads[i] : nullptr);
+
+   PackedFaces carriedPacked;
+   carriedPacked.pack(carriedFaces);
+   carriedPacked.unpack(unpackedFaces);
+   same = unpackedFaces.size() == payloadFaces.size();
+
+   for (std::size_t i = 0; i != payloadFaces.size() && same; i++)
+   {
+      auto around = unpackedFaces.search(payloadFaces[i].v1);
+      auto found = around.find(payloadFaces[i]);
+      same = found != around.end() &&
+             found->second == (i % 2 ? &payloads[i] : nullptr);
+   }
+
+   std::cout << "  Payload: " << (same ? "Yes" : "No") << std::endl;
+
+
+   /* Test 29. Cotangent Laplacian and lumped mass.
+       Rows of the Laplacian sum to 0 and the masses add up to the area
+       of the octasphere, 50.263. The Dirichlet energy of the coordinate
+       functions of a sphere is twice its area, about 100.5.
+       Doubling every position leaves the cotangents as they are and
+       makes the masses 4 times larger, and the update gives exactly
+       what a new build gives. Updating after a vertex is erased is
+       refused and keeps the weights.
+    */
+   std::cout << "\n\nTest 29. 0, 50.263, 100.5, Yes, Yes, Yes." << std::endl;
+
+   Laplacian laplacian;
+   start = std::chrono::steady_clock::now();
+   laplacian.build(sphereVerts, sphereFaces);
+   end = std::chrono::steady_clock::now();
+   std::cout << "  Build:   "
+             << std::chrono::duration<double, std::milli>(end - start).count()
+             << " ms" << std::endl;
+
+   auto &rows = laplacian.offsets();
+   auto &columns = laplacian.columns();
+   auto values = laplacian.values();
+   auto mass = laplacian.mass();
+   double worst = 0, total = 0, energy = 0;
+
+   vectorVerts.resize(sphereVerts.size());
+   sphereVerts.copy_all(&vectorVerts[0]);
+
+   for (std::size_t i = 0; i + 1 < rows.size(); i++)
+   {
+      double sum = 0;
+
+      for (auto e = rows[i]; e != rows[i + 1]; e++)
+      {
+         auto &a = vectorVerts[i], &b = vectorVerts[columns[e]];
+         sum += values[e];
+         energy += values[e] * (a.x * b.x + a.y * b.y + a.z * b.z);
+      }
+
+      worst = std::max(worst, std::abs(sum));
+      total += mass[i];
+   }
+
+   std::cout << std::setprecision(5) << "  Rows:    " << (worst < 1e-9 ? 0 : worst)
+             << std::endl;
+   std::cout << "  Mass:    " << total << std::endl;
+   std::cout << "  Energy:  " << std::setprecision(4) << energy
+             << std::setprecision(6) << std::endl;
+
+   std::vector<std::size_t> moved(vectorVerts.size());
+
+   for (std::size_t i = 0; i != vectorVerts.size(); i++)
+   {
+      moved[i] = i;
+      vectorVerts[i] = Vert(2 * vectorVerts[i].x, 2 * vectorVerts[i].y,
+                            2 * vectorVerts[i].z);
+   }
+
+   Verts scaledVerts = sphereVerts;
+   scaledVerts.modify(&moved[0], &vectorVerts[0], moved.size());
+   start = std::chrono::steady_clock::now();
+   laplacian.update(scaledVerts);
+   end = std::chrono::steady_clock::now();
+   std::cout << "  Update:  "
+             << std::chrono::duration<double, std::milli>(end - start).count()
+             << " ms" << std::endl;
+
+   same = true;
+
+   for (std::size_t i = 0; i != values.size(); i++)
+      same = same && std::abs(laplacian.values()[i] - values[i]) < 1e-9;
+
+   for (std::size_t i = 0; i != mass.size(); i++)
+      same = same && std::abs(laplacian.mass()[i] - 4 * mass[i]) < 1e-12;
+
+   std::cout << "  Scaled:  " << (same ? "Yes" : "No") << std::endl;
+
+   Laplacian fresh;
+   fresh.build(scaledVerts, sphereFaces);
+   std::cout << "  Rebuilt: "
+             << (fresh.values() == laplacian.values() &&
+                 fresh.mass() == laplacian.mass() &&
+                 fresh.columns() == laplacian.columns()
+                    ? "Yes" : "No")
+             << std::endl;
+
+   scaledVerts.erase(0);
+   std::cout << "  Erased:  "
+             << (!laplacian.update(scaledVerts) &&
+                 fresh.values() == laplacian.values() &&
+                 fresh.mass() == laplacian.mass()
+                    ? "Yes" : "No")
+             << std::endl;
+
+
+   /* Test 30. Integrity checks.
+       The octasphere, faces1 after all its edits, a Faces with the dual
+       graph and a Faces with deferred indexes all pass. Once a vertex
+       is erased from Verts the faces around it dangle and the check
+       against Verts fails.
+    */
+   std::cout << "\n\nTest 30. Yes, Yes, Yes, Yes, No." << std::endl;
+
+   start = std::chrono::steady_clock::now();
+   auto valid = sphereVerts.verify() && sphereEdges.verify() &&
+                sphereFaces.verify(sphereVerts);
+   end = std::chrono::steady_clock::now();
+   std::cout << "  Sphere:   " << (valid ? "Yes" : "No") << " in "
+             << std::chrono::duration<double, std::milli>(end - start).count()
+             << " ms" << std::endl;
+   std::cout << "  Edited:   "
+             << (faces1.verify() && edges1.verify() ? "Yes" : "No")
+             << std::endl;
+
+   linkedFaces.erase(vectorFaces[0]);
+   std::cout << "  Linked:   " << (linkedFaces.verify() ? "Yes" : "No")
+             << std::endl;
+
+   Faces deferredFaces;
+   deferredFaces.defer(true);
+   packedFaces.unpack(deferredFaces);
+   deferredFaces.erase(vectorFaces[0]);
+   std::cout << "  Deferred: "
+             << (deferredFaces.defer() && deferredFaces.verify() ? "Yes"
+                                                                 : "No")
+             << std::endl;
+
+   Verts erasedVerts = sphereVerts;
+   erasedVerts.erase(vectorFaces[0].v1);
+   std::cout << "  Dangling: "
+             << (erasedVerts.verify() && sphereFaces.verify(erasedVerts)
+                    ? "Yes" : "No")
+             << std::endl;
+
+
+   /* Test 31. Reduced precision vertices.
+       The octasphere is packed as floats and as 16 bit steps across its
+       bounding box, which cuts coordinates to a half and a quarter of
+       doubles. Every coordinate stays within the stated error, lookups
+       agree with the bulk copy, and the gap left in erasedVerts comes
+       back when unpacking. A NaN cannot be quantized and is refused,
+       while floats keep an infinity. A gap of 10^9 indices comes back at
+       once, and unpacking keeps the deferred state of the target.
+    */
+   std::cout << "\n\nTest 31. Yes, Yes, Yes, Yes, Yes." << std::endl;
+
+   std::vector<Vert> exactVerts(sphereVerts.size());
+   sphereVerts.copy_all(&exactVerts[0]);
+
+   for (auto quantize : {false, true})
+   {
+      PackedVerts packedVerts;
+      start = std::chrono::steady_clock::now();
+      packedVerts.pack(sphereVerts, quantize);
+      end = std::chrono::steady_clock::now();
+
+      std::vector<Vert> lossy(packedVerts.size());
+      packedVerts.copy_all(&lossy[0]);
+      auto bound = packedVerts.error();
+
+      same = lossy.size() == exactVerts.size();
+      for (std::size_t i = 0; same && i != lossy.size(); i++)
+         same = std::abs(lossy[i].x - exactVerts[i].x) <= bound.x &&
+                std::abs(lossy[i].y - exactVerts[i].y) <= bound.y &&
+                std::abs(lossy[i].z - exactVerts[i].z) <= bound.z &&
+                packedVerts[i] == lossy[i];
+
+      std::cout << (quantize ? "  Quantized: " : "  Float:     ")
+                << (same ? "Yes" : "No") << ", "
+                << packedVerts.memory()["coords"] / 1000 << " kB against "
+                << exactVerts.size() * sizeof(Vert) / 1000
+                << " kB, error " << std::max(bound.x, std::max(bound.y, bound.z))
+                << " in "
+                << std::chrono::duration<double, std::milli>(end - start).count()
+                << " ms" << std::endl;
+   }
+
+   PackedVerts gappedVerts;
+   gappedVerts.pack(erasedVerts, false);
+   Verts restoredVerts;
+   gappedVerts.unpack(restoredVerts);
+   auto gap = vectorFaces[0].v1;
+   same = restoredVerts.size() == erasedVerts.size() &&
+          restoredVerts.verify() &&
+          gappedVerts[gap].x == std::numeric_limits<double>::infinity() &&
+          restoredVerts[gap + 1] == gappedVerts[gap + 1];
+   std::cout << "  Gap:       " << (same ? "Yes" : "No") << std::endl;
+
+   Verts oddVerts;
+   oddVerts.insert(Vert(0, 0, 0));
+   oddVerts.insert(Vert(std::numeric_limits<double>::quiet_NaN(), 0, 0));
+   oddVerts.insert(Vert(std::numeric_limits<double>::infinity(), 0, 0));
+   same = !gappedVerts.pack(oddVerts, true) && gappedVerts.size() == 0 &&
+          gappedVerts.pack(oddVerts, false) && gappedVerts.size() == 3 &&
+          std::isnan(gappedVerts[1].x) && std::isinf(gappedVerts[2].x);
+   std::cout << "  Odd:       " << (same ? "Yes" : "No") << std::endl;
+
+   Verts farVerts;
+   farVerts.insert(Vert(1, 2, 3));
+   farVerts.insert(Vert(4, 5, 6));
+   farVerts.renumber(std::vector<std::size_t>{0, 1000000000});
+   gappedVerts.pack(farVerts, false);
+   restoredVerts.defer(true);
+   start = std::chrono::steady_clock::now();
+   gappedVerts.unpack(restoredVerts);
+   end = std::chrono::steady_clock::now();
+   same = restoredVerts.defer() && restoredVerts.size() == 2 &&
+          restoredVerts[1000000000] == Vert(4, 5, 6) &&
+          restoredVerts.search(Vert(4, 5, 6)).count(1000000000) == 1;
+   restoredVerts.defer(false);
+   std::cout << "  Far:       " << (same ? "Yes" : "No") << " in "
+             << std::chrono::duration<double, std::milli>(end - start).count()
+             << " ms" << std::endl;
+
+
+   system("pause");
+
+   return 0;
+}
@@ -0,0 +1,4 @@
+@echo off
+rem gcc 9.2.0 (tdm64) win10
+g++ topo.cpp -O3 -std=c++11 -Wall -pedantic -DBUILD_LIB -shared -L./ -lmesh -o topo.dll
+pause
@@ -1,725 +1,1985 @@
-#include "mesh.h"
-#include <limits>
-
-
-Vert::Vert() {}
-
-Vert::Vert(double x, double y, double z)
-    : x(x), y(y), z(z) {}
-
-bool Vert::operator==(const Vert &other) const
-{
-    if (this->x != other.x)
-        return false;
-    else if (this->y != other.y)
-        return false;
-    else if (this->z != other.z)
-        return false;
-    else
-        return true;
-}
-
-bool Vert::operator<(const Vert &other) const
-{
-    if (this->x != other.x)
-        return this->x < other.x;
-    else if (this->y != other.y)
-        return this->y < other.y;
-    else if (this->z != other.z)
-        return this->z < other.z;
-    else
-        return false;
-}
-
-
-Edge::Edge() {}
-
-Edge::Edge(std::size_t v1, std::size_t v2)
-    : v1(v1), v2(v2) {}
-
-bool Edge::operator==(const Edge &other) const
-{
-    if (this->v1 != other.v1)
-        return false;
-    else if (this->v2 != other.v2)
-        return false;
-    else
-        return true;
-}
-
-bool Edge::operator<(const Edge &other) const
-{
-    if (this->v1 != other.v1)
-        return this->v1 < other.v1;
-    else if (this->v2 != other.v2)
-        return this->v2 < other.v2;
-    else
-        return false;
-}
-
-bool Edge::OrderByV2::operator()(const Edge &edge1,
-                                 const Edge &edge2) const
-{
-    return edge1.v2 < edge2.v2;
-}
-
-
-Face::Face() {}
-
-Face::Face(std::size_t v1, std::size_t v2, std::size_t v3)
-    : v1(v1), v2(v2), v3(v3) {}
-
-bool Face::operator==(const Face &other) const
-{
-    if (this->v1 != other.v1)
-        return false;
-    else if (this->v2 != other.v2)
-        return false;
-    else if (this->v3 != other.v3)
-        return false;
-    else
-        return true;
-}
-
-bool Face::operator<(const Face &other) const
-{
-    if (this->v1 != other.v1)
-        return this->v1 < other.v1;
-    else if (this->v2 != other.v2)
-        return this->v2 < other.v2;
-    else if (this->v3 != other.v3)
-        return this->v3 < other.v3;
-    else
-        return false;
-}
-
-bool Face::OrderByV2::operator()(const Face &face1,
-                                 const Face &face2) const
-{
-    return face1.v2 < face2.v2;
-}
-
-bool Face::OrderByV3::operator()(const Face &face1,
-                                 const Face &face2) const
-{
-    return face1.v3 < face2.v3;
-}
-
-
-Vert Verts::operator[](std::size_t idx) const
-{
-    auto found = this->verts.find(idx);
-
-    if (found == this->verts.cend())
-    {
-        auto INF = std::numeric_limits<double>::infinity();
-        return Vert(INF, INF, INF);
-    }
-    else
-        return found->second;
-}
-
-void Verts::insert(const Vert &vert)
-{
-    if (this->verts.empty())
-    {
-        this->verts[0] = vert;
-        this->vertsInv.insert(std::pair<Vert, std::size_t>(vert, 0));
-    }
-    else
-    {
-        auto idx = this->verts.crbegin()->first + 1;
-        this->verts[idx] = vert;
-        this->vertsInv.insert(std::pair<Vert, std::size_t>(vert, idx));
-    }
-}
-
-void Verts::modify(std::size_t idx, const Vert &vert)
-{
-    auto found = this->verts.find(idx);
-
-    if (found == this->verts.cend())
-        return;
-
-    auto range = this->vertsInv.equal_range(found->second);
-    auto lower = range.first, upper = range.second;
-
-    for (auto iter = lower; iter != upper; iter++)
-        if (iter->first == found->second && iter->second == idx)
-        {
-            this->vertsInv.erase(iter);
-            break;
-        }
-
-    this->vertsInv.insert(std::pair<Vert, std::size_t>(vert, idx));
-    found->second = vert;
-}
-
-void Verts::erase(std::size_t idx)
-{
-    auto found = this->verts.find(idx);
-
-    if (found == this->verts.cend())
-        return;
-
-    auto range = this->vertsInv.equal_range(found->second);
-    auto lower = range.first, upper = range.second;
-
-    for (auto iter = lower; iter != upper; iter++)
-        if (iter->first == found->second && iter->second == idx)
-        {
-            this->vertsInv.erase(iter);
-            break;
-        }
-
-    this->verts.erase(found);
-}
-
-void Verts::erase(const Vert &vert)
-{
-    auto range = this->vertsInv.equal_range(vert);
-    auto lower = range.first, upper = range.second;
-
-    for (auto iter = lower; iter != upper; iter++)
-        this->verts.erase(iter->second);
-
-    this->vertsInv.erase(vert);
-}
-
-void Verts::clear()
-{
-    this->verts.clear();
-    this->vertsInv.clear();
-}
-
-std::size_t Verts::size() const
-{
-    return this->verts.size();
-}
-
-std::set<std::size_t> Verts::search(const Vert &vert) const
-{
-    std::set<std::size_t> set;
-    auto range = this->vertsInv.equal_range(vert);
-    auto lower = range.first, upper = range.second;
-
-    for (auto iter = lower; iter != upper; iter++)
-        set.insert(iter->second);
-
-    return set;
-}
-
-void Verts::copy_all(Vert *ptr) const
-{
-    auto lower = this->verts.cbegin();
-    auto upper = this->verts.cend();
-
-    for (auto iter = lower; iter != upper; iter++)
-        *ptr++ = iter->second;
-}
-
-
-void Edges::insert(Edge edge)
-{
-    if (edge.v1 == edge.v2)
-        return;
-
-    if (edge.v1 > edge.v2)
-        std::swap(edge.v1, edge.v2);
-
-    auto before = this->edgesByV1.size();
-    this->edgesByV1.insert(edge);
-
-    if (this->edgesByV1.size() > before)
-        this->edgesByV2.insert(edge);
-}
-
-void Edges::erase(std::size_t idx)
-{
-    auto lower = this->edgesByV1.lower_bound(Edge(idx, 0));
-    auto upper = this->edgesByV1.upper_bound(Edge(idx, -1));
-
-    for (auto iter = lower; iter != upper;)
-    {
-        auto range2 = this->edgesByV2.equal_range(*iter);
-        auto lower2 = range2.first, upper2 = range2.second;
-
-        for (auto iter2 = lower2; iter2 != upper2; iter2++)
-            if (*iter2 == *iter)
-            {
-                this->edgesByV2.erase(iter2);
-                break;
-            }
-
-        this->edgesByV1.erase(iter++);
-    }
-
-    auto range = this->edgesByV2.equal_range(Edge(0, idx));
-    lower = range.first, upper = range.second;
-
-    for (auto iter = lower; iter != upper; iter++)
-        this->edgesByV1.erase(*iter);
-
-    this->edgesByV2.erase(Edge(0, idx));
-}
-
-void Edges::erase(Edge edge)
-{
-    if (edge.v1 > edge.v2)
-        std::swap(edge.v1, edge.v2);
-
-    auto range = this->edgesByV2.equal_range(edge);
-    auto lower = range.first, upper = range.second;
-
-    for (auto iter = lower; iter != upper; iter++)
-        if (*iter == edge)
-        {
-            this->edgesByV2.erase(iter);
-            break;
-        }
-
-    this->edgesByV1.erase(edge);
-}
-
-void Edges::clear()
-{
-    this->edgesByV1.clear();
-    this->edgesByV2.clear();
-}
-
-bool Edges::find(Edge edge) const
-{
-    if (edge.v1 > edge.v2)
-        std::swap(edge.v1, edge.v2);
-
-    return this->edgesByV1.find(edge) != this->edgesByV1.cend();
-}
-
-std::size_t Edges::size() const
-{
-    return this->edgesByV1.size();
-}
-
-std::set<Edge> Edges::search(std::size_t idx) const
-{
-    std::set<Edge> set;
-    auto lower = this->edgesByV1.lower_bound(Edge(idx, 0));
-    auto upper = this->edgesByV1.upper_bound(Edge(idx, -1));
-
-    for (auto iter = lower; iter != upper; iter++)
-        set.insert(*iter);
-
-    auto range = this->edgesByV2.equal_range(Edge(0, idx));
-    lower = range.first, upper = range.second;
-
-    for (auto iter = lower; iter != upper; iter++)
-        set.insert(*iter);
-
-    return set;
-}
-
-void Edges::copy_all(Edge *ptr) const
-{
-    auto lower = this->edgesByV1.cbegin();
-    auto upper = this->edgesByV1.cend();
-
-    for (auto iter = lower; iter != upper; iter++)
-        *ptr++ = *iter;
-}
-
-
-void *Faces::operator[](Face face) const
-{
-    if (face.v2 < face.v3 && face.v2 < face.v1)
-        face = Face(face.v2, face.v3, face.v1);
-    else if (face.v3 < face.v1 && face.v3 < face.v2)
-        face = Face(face.v3, face.v1, face.v2);
-
-    auto found = this->facesByV1.find(face);
-
-    if (found == this->facesByV1.cend())
-        return nullptr;
-    else
-        return found->second;
-}
-
-void Faces::insert(Face face, void *ptr)
-{
-    if (face.v1 == face.v2 || face.v2 == face.v3 || face.v3 == face.v1)
-        return;
-
-    if (face.v2 < face.v3 && face.v2 < face.v1)
-        face = Face(face.v2, face.v3, face.v1);
-    else if (face.v3 < face.v1 && face.v3 < face.v2)
-        face = Face(face.v3, face.v1, face.v2);
-
-    auto before = this->facesByV1.size();
-    this->facesByV1[face] = ptr;
-
-    if (this->facesByV1.size() > before)
-    {
-        this->facesByV2.insert(std::pair<Face, void *>(face, ptr));
-        this->facesByV3.insert(std::pair<Face, void *>(face, ptr));
-    }
-    else
-    {
-        auto range = facesByV2.equal_range(face);
-        auto lower = range.first, upper = range.second;
-
-        for (auto iter = lower; iter != upper; iter++)
-            if (iter->first == face)
-            {
-                iter->second = ptr;
-                break;
-            }
-
-        range = facesByV3.equal_range(face);
-        lower = range.first, upper = range.second;
-
-        for (auto iter = lower; iter != upper; iter++)
-            if (iter->first == face)
-            {
-                iter->second = ptr;
-                break;
-            }
-    }
-}
-
-void Faces::insert(const Face &face, void *ptr, Edges &edges)
-{
-    this->insert(face, ptr);
-    edges.insert(Edge(face.v1, face.v2));
-    edges.insert(Edge(face.v2, face.v3));
-    edges.insert(Edge(face.v3, face.v1));
-}
-
-void Faces::erase(std::size_t idx)
-{
-    auto lower = this->facesByV1.lower_bound(Face(idx, 0, 0));
-    auto upper = this->facesByV1.upper_bound(Face(idx, -1, -1));
-
-    for (auto iter = lower; iter != upper;)
-    {
-        auto range2 = this->facesByV2.equal_range(iter->first);
-        auto lower2 = range2.first, upper2 = range2.second;
-
-        for (auto iter2 = lower2; iter2 != upper2; iter2++)
-            if (iter2->first == iter->first)
-            {
-                this->facesByV2.erase(iter2);
-                break;
-            }
-
-        auto range3 = this->facesByV3.equal_range(iter->first);
-        auto lower3 = range3.first, upper3 = range3.second;
-
-        for (auto iter3 = lower3; iter3 != upper3; iter3++)
-            if (iter3->first == iter->first)
-            {
-                this->facesByV3.erase(iter3);
-                break;
-            }
-
-        this->facesByV1.erase(iter++);
-    }
-
-    auto range = this->facesByV2.equal_range(Face(0, idx, 0));
-    lower = range.first, upper = range.second;
-
-    for (auto iter = lower; iter != upper; iter++)
-    {
-        auto range3 = this->facesByV3.equal_range(iter->first);
-        auto lower3 = range3.first, upper3 = range3.second;
-
-        for (auto iter3 = lower3; iter3 != upper3; iter3++)
-            if (iter3->first == iter->first)
-            {
-                this->facesByV3.erase(iter3);
-                break;
-            }
-
-        this->facesByV1.erase(iter->first);
-    }
-
-    range = this->facesByV3.equal_range(Face(0, 0, idx));
-    lower = range.first, upper = range.second;
-
-    for (auto iter = lower; iter != upper; iter++)
-    {
-        auto range2 = this->facesByV2.equal_range(iter->first);
-        auto lower2 = range2.first, upper2 = range2.second;
-
-        for (auto iter2 = lower2; iter2 != upper2; iter2++)
-            if (iter2->first == iter->first)
-            {
-                this->facesByV2.erase(iter2);
-                break;
-            }
-
-        this->facesByV1.erase(iter->first);
-    }
-
-    this->facesByV2.erase(Face(0, idx, 0));
-    this->facesByV3.erase(Face(0, 0, idx));
-}
-
-void Faces::erase(std::size_t idx, Edges &edges)
-{
-    this->erase(idx);
-    edges.erase(idx);
-}
-
-void Faces::erase(const Edge &edge)
-{
-    auto lower = this->facesByV1.lower_bound(Face(edge.v1, 0, 0));
-    auto upper = this->facesByV1.upper_bound(Face(edge.v1, -1, -1));
-
-    for (auto iter = lower; iter != upper;)
-        if (iter->first.v2 == edge.v2 || iter->first.v3 == edge.v2)
-        {
-            auto range2 = this->facesByV2.equal_range(iter->first);
-            auto lower2 = range2.first, upper2 = range2.second;
-
-            for (auto iter2 = lower2; iter2 != upper2; iter2++)
-                if (iter2->first == iter->first)
-                {
-                    this->facesByV2.erase(iter2);
-                    break;
-                }
-
-            auto range3 = this->facesByV3.equal_range(iter->first);
-            auto lower3 = range3.first, upper3 = range3.second;
-
-            for (auto iter3 = lower3; iter3 != upper3; iter3++)
-                if (iter3->first == iter->first)
-                {
-                    this->facesByV3.erase(iter3);
-                    break;
-                }
-
-            this->facesByV1.erase(iter++);
-        }
-        else
-            iter++;
-
-    lower = this->facesByV1.lower_bound(Face(edge.v2, 0, 0));
-    upper = this->facesByV1.upper_bound(Face(edge.v2, -1, -1));
-
-    for (auto iter = lower; iter != upper;)
-        if (iter->first.v2 == edge.v1 || iter->first.v3 == edge.v1)
-        {
-            auto range2 = this->facesByV2.equal_range(iter->first);
-            auto lower2 = range2.first, upper2 = range2.second;
-
-            for (auto iter2 = lower2; iter2 != upper2; iter2++)
-                if (iter2->first == iter->first)
-                {
-                    this->facesByV2.erase(iter2);
-                    break;
-                }
-
-            auto range3 = this->facesByV3.equal_range(iter->first);
-            auto lower3 = range3.first, upper3 = range3.second;
-
-            for (auto iter3 = lower3; iter3 != upper3; iter3++)
-                if (iter3->first == iter->first)
-                {
-                    this->facesByV3.erase(iter3);
-                    break;
-                }
-
-            this->facesByV1.erase(iter++);
-        }
-        else
-            iter++;
-
-    auto range = this->facesByV2.equal_range(Face(0, edge.v1, 0));
-    lower = range.first, upper = range.second;
-
-    for (auto iter = lower; iter != upper;)
-        if (iter->first.v3 == edge.v2)
-        {
-            auto range3 = this->facesByV3.equal_range(iter->first);
-            auto lower3 = range3.first, upper3 = range3.second;
-
-            for (auto iter3 = lower3; iter3 != upper3; iter3++)
-                if (iter3->first == iter->first)
-                {
-                    this->facesByV3.erase(iter3);
-                    break;
-                }
-
-            this->facesByV1.erase(iter->first);
-            this->facesByV2.erase(iter++);
-        }
-        else
-            iter++;
-
-    range = this->facesByV2.equal_range(Face(0, edge.v2, 0));
-    lower = range.first, upper = range.second;
-
-    for (auto iter = lower; iter != upper;)
-        if (iter->first.v3 == edge.v1)
-        {
-            auto range3 = this->facesByV3.equal_range(iter->first);
-            auto lower3 = range3.first, upper3 = range3.second;
-
-            for (auto iter3 = lower3; iter3 != upper3; iter3++)
-                if (iter3->first == iter->first)
-                {
-                    this->facesByV3.erase(iter3);
-                    break;
-                }
-
-            this->facesByV1.erase(iter->first);
-            this->facesByV2.erase(iter++);
-        }
-        else
-            iter++;
-}
-
-void Faces::erase(const Edge &edge, Edges &edges)
-{
-    this->erase(edge);
-    edges.erase(edge);
-}
-
-void Faces::erase(Face face)
-{
-    if (face.v2 < face.v3 && face.v2 < face.v1)
-        face = Face(face.v2, face.v3, face.v1);
-    else if (face.v3 < face.v1 && face.v3 < face.v2)
-        face = Face(face.v3, face.v1, face.v2);
-
-    auto range = facesByV2.equal_range(face);
-    auto lower = range.first, upper = range.second;
-
-    for (auto iter = lower; iter != upper; iter++)
-        if (iter->first == face)
-        {
-            this->facesByV2.erase(iter);
-            break;
-        }
-
-    range = facesByV3.equal_range(face);
-    lower = range.first, upper = range.second;
-
-    for (auto iter = lower; iter != upper; iter++)
-        if (iter->first == face)
-        {
-            this->facesByV3.erase(iter);
-            break;
-        }
-
-    this->facesByV1.erase(face);
-}
-
-void Faces::erase(const Face &face, Edges &edges)
-{
-    this->erase(face);
-
-    if (this->search(Edge(face.v1, face.v2)).empty())
-        edges.erase(Edge(face.v1, face.v2));
-
-    if (this->search(Edge(face.v2, face.v3)).empty())
-        edges.erase(Edge(face.v2, face.v3));
-
-    if (this->search(Edge(face.v3, face.v1)).empty())
-        edges.erase(Edge(face.v3, face.v1));
-}
-
-void Faces::clear()
-{
-    this->facesByV1.clear();
-    this->facesByV2.clear();
-    this->facesByV3.clear();
-}
-
-std::size_t Faces::size() const
-{
-    return this->facesByV1.size();
-}
-
-std::map<Face, void *> Faces::search(std::size_t idx) const
-{
-    std::map<Face, void *> map;
-    auto lower = this->facesByV1.lower_bound(Face(idx, 0, 0));
-    auto upper = this->facesByV1.upper_bound(Face(idx, -1, -1));
-
-    for (auto iter = lower; iter != upper; iter++)
-        map[iter->first] = iter->second;
-
-    auto range = this->facesByV2.equal_range(Face(0, idx, 0));
-    lower = range.first, upper = range.second;
-
-    for (auto iter = lower; iter != upper; iter++)
-        map[iter->first] = iter->second;
-
-    range = this->facesByV3.equal_range(Face(0, 0, idx));
-    lower = range.first, upper = range.second;
-
-    for (auto iter = lower; iter != upper; iter++)
-        map[iter->first] = iter->second;
-
-    return map;
-}
-
-std::map<Face, void *> Faces::search(const Edge &edge) const
-{
-    std::map<Face, void *> map;
-    auto lower = this->facesByV1.lower_bound(Face(edge.v1, 0, 0));
-    auto upper = this->facesByV1.upper_bound(Face(edge.v1, -1, -1));
-
-    for (auto iter = lower; iter != upper; iter++)
-        if (iter->first.v2 == edge.v2 || iter->first.v3 == edge.v2)
-            map[iter->first] = iter->second;
-
-    lower = this->facesByV1.lower_bound(Face(edge.v2, 0, 0));
-    upper = this->facesByV1.upper_bound(Face(edge.v2, -1, -1));
-
-    for (auto iter = lower; iter != upper; iter++)
-        if (iter->first.v2 == edge.v1 || iter->first.v3 == edge.v1)
-            map[iter->first] = iter->second;
-
-    auto range = this->facesByV2.equal_range(Face(0, edge.v1, 0));
-    lower = range.first, upper = range.second;
-
-    for (auto iter = lower; iter != upper; iter++)
-        if (iter->first.v3 == edge.v2)
-            map[iter->first] = iter->second;
-
-    range = this->facesByV2.equal_range(Face(0, edge.v2, 0));
-    lower = range.first, upper = range.second;
-
-    for (auto iter = lower; iter != upper; iter++)
-        if (iter->first.v3 == edge.v1)
-            map[iter->first] = iter->second;
-
-    return map;
-}
-
-void Faces::sync(Edges &edges) const
-{
-    edges.clear();
-    auto lower = this->facesByV1.cbegin();
-    auto upper = this->facesByV1.cend();
-
-    for (auto iter = lower; iter != upper; iter++)
-    {
-        edges.insert(Edge(iter->first.v1, iter->first.v2));
-        edges.insert(Edge(iter->first.v2, iter->first.v3));
-        edges.insert(Edge(iter->first.v3, iter->first.v1));
-    }
-}
-
-void Faces::copy_all(Face *ptrFace, void **ptrPtr) const
-{
-    auto lower = this->facesByV1.cbegin();
-    auto upper = this->facesByV1.cend();
-
-    for (auto iter = lower; iter != upper; iter++)
-    {
-        *ptrFace++ = iter->first;
-        *ptrPtr++ = iter->second;
-    }
-}
\ No newline at end of file
+#include "mesh.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+
+// A red-black tree node holds a colour and three links ahead of its value,
+// and the allocator adds a word of header and rounds up to 16 bytes.
+template <typename Value>
+static std::size_t node_size()
+{
+    auto bytes = sizeof(void *) + 3 * sizeof(void *) + sizeof(Value);
+    return (bytes + sizeof(void *) + 15) / 16 * 16;
+}
+
+template <typename Tree>
+static std::size_t tree_size(const Tree &tree)
+{
+    return sizeof(Tree) +
+           tree.size() * node_size<typename Tree::value_type>();
+}
+
+// Looks up many keys at once: the probes are sorted and every thread walks
+// the tree forward through its share of them, only falling back to a
+// root-to-leaf search when the next probe is more than a few nodes ahead.
+template <typename Tree, typename Key, typename Get, typename Emit>
+static void merge_join(const Tree &tree, const Key *keys, std::size_t size,
+                       Get get, Emit emit)
+{
+    std::vector<std::pair<Key, std::size_t>> order(size);
+
+    for (std::size_t i = 0; i != size; i++)
+        order[i] = std::pair<Key, std::size_t>(keys[i], i);
+
+    std::sort(order.begin(), order.end());
+
+    parallel_for(size, 1024, [&](std::size_t begin, std::size_t end) {
+        auto iter = tree.cend();
+
+        for (auto i = begin; i != end; i++)
+        {
+            const Key &key = order[i].first;
+
+            if (i == begin)
+                iter = tree.lower_bound(key);
+            else
+            {
+                for (int step = 0; step != 8 && iter != tree.cend() &&
+                                   get(*iter) < key;
+                     step++)
+                    iter++;
+
+                if (iter != tree.cend() && get(*iter) < key)
+                    iter = tree.lower_bound(key);
+            }
+
+            emit(order[i].second, iter);
+        }
+    });
+}
+
+
+// A map sending two indices to one would fold records together and leave
+// the indexes disagreeing, so renumbering refuses it up front.
+static bool injective(const std::vector<std::size_t> &map)
+{
+    std::vector<std::size_t> sorted;
+    sorted.reserve(map.size());
+
+    for (std::size_t i = 0; i != map.size(); i++)
+        if (map[i] != std::size_t(-1))
+            sorted.push_back(map[i]);
+
+    std::sort(sorted.begin(), sorted.end());
+    return std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end();
+}
+
+
+// Secondary indexes left stale by deferred writes are rebuilt by the first
+// const call that needs them. Concurrent const calls may all find the flag
+// set, so the rebuild takes the lock and checks again, and the flag is
+// only cleared once everything it guards is complete. Copies take the
+// value, every object keeps its own lock.
+Lazy::Lazy()
+    : stale(false) {}
+
+Lazy::Lazy(const Lazy &other)
+    : stale(other.stale.load()) {}
+
+Lazy &Lazy::operator=(const Lazy &other)
+{
+    this->stale.store(other.stale.load());
+    return *this;
+}
+
+Lazy &Lazy::operator=(bool stale)
+{
+    this->stale.store(stale, std::memory_order_release);
+    return *this;
+}
+
+Lazy::operator bool() const
+{
+    return this->stale.load(std::memory_order_acquire);
+}
+
+
+Vert::Vert() {}
+
+Vert::Vert(double x, double y, double z)
+    : x(x), y(y), z(z) {}
+
+bool Vert::operator==(const Vert &other) const
+{
+    if (this->x != other.x)
+        return false;
+    else if (this->y != other.y)
+        return false;
+    else if (this->z != other.z)
+        return false;
+    else
+        return true;
+}
+
+bool Vert::operator<(const Vert &other) const
+{
+    if (this->x != other.x)
+        return this->x < other.x;
+    else if (this->y != other.y)
+        return this->y < other.y;
+    else if (this->z != other.z)
+        return this->z < other.z;
+    else
+        return false;
+}
+
+
+Edge::Edge() {}
+
+Edge::Edge(std::size_t v1, std::size_t v2)
+    : v1(v1), v2(v2) {}
+
+bool Edge::operator==(const Edge &other) const
+{
+    if (this->v1 != other.v1)
+        return false;
+    else if (this->v2 != other.v2)
+        return false;
+    else
+        return true;
+}
+
+bool Edge::operator<(const Edge &other) const
+{
+    if (this->v1 != other.v1)
+        return this->v1 < other.v1;
+    else if (this->v2 != other.v2)
+        return this->v2 < other.v2;
+    else
+        return false;
+}
+
+bool Edge::OrderByV2::operator()(const Edge &edge1,
+                                 const Edge &edge2) const
+{
+    return edge1.v2 < edge2.v2;
+}
+
+
+Face::Face() {}
+
+Face::Face(std::size_t v1, std::size_t v2, std::size_t v3)
+    : v1(v1), v2(v2), v3(v3) {}
+
+bool Face::operator==(const Face &other) const
+{
+    if (this->v1 != other.v1)
+        return false;
+    else if (this->v2 != other.v2)
+        return false;
+    else if (this->v3 != other.v3)
+        return false;
+    else
+        return true;
+}
+
+bool Face::operator<(const Face &other) const
+{
+    if (this->v1 != other.v1)
+        return this->v1 < other.v1;
+    else if (this->v2 != other.v2)
+        return this->v2 < other.v2;
+    else if (this->v3 != other.v3)
+        return this->v3 < other.v3;
+    else
+        return false;
+}
+
+bool Face::OrderByV2::operator()(const Face &face1,
+                                 const Face &face2) const
+{
+    return face1.v2 < face2.v2;
+}
+
+bool Face::OrderByV3::operator()(const Face &face1,
+                                 const Face &face2) const
+{
+    return face1.v3 < face2.v3;
+}
+
+
+// Every element is hashed on its own and the hashes are combined with XOR,
+// so a fingerprint does not depend on insertion order and each insert or
+// erase updates it in constant time. Face payloads are not part of it.
+static std::uint64_t mix(std::uint64_t value)
+{
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+static std::uint64_t mix(std::uint64_t value, double coord)
+{
+    std::uint64_t bits;
+    coord += 0.0;
+    std::memcpy(&bits, &coord, sizeof(bits));
+    return mix(value ^ bits);
+}
+
+static std::uint64_t digest(std::size_t idx, const Vert &vert)
+{
+    return mix(mix(mix(mix(idx + 1), vert.x), vert.y), vert.z);
+}
+
+static std::uint64_t digest(const Edge &edge)
+{
+    return mix(mix(edge.v1 + 2) ^ edge.v2);
+}
+
+static std::uint64_t digest(const Face &face)
+{
+    return mix(mix(mix(face.v1 + 3) ^ face.v2) ^ face.v3);
+}
+
+// Sums and XORs per-entry hashes in parallel blocks. Both are independent
+// of order, so two indexes holding the same entries agree on them however
+// each one orders its entries.
+template <typename Value, typename Hash>
+static void checksum(const std::vector<Value> &vector, Hash hash,
+                     std::uint64_t &sum, std::uint64_t &bits)
+{
+    auto blocks = (vector.size() + 4095) / 4096;
+    std::vector<std::uint64_t> sums(blocks, 0), xors(blocks, 0);
+
+    parallel_for(blocks, 1, [&](std::size_t begin, std::size_t end) {
+        for (auto block = begin; block != end; block++)
+        {
+            auto last = std::min(block * 4096 + 4096, vector.size());
+
+            for (auto i = block * 4096; i != last; i++)
+            {
+                auto value = hash(vector[i]);
+                sums[block] += value;
+                xors[block] ^= value;
+            }
+        }
+    });
+
+    sum = 0, bits = 0;
+
+    for (std::size_t i = 0; i != blocks; i++)
+        sum += sums[i], bits ^= xors[i];
+}
+
+template <typename Test>
+static bool all(std::size_t size, Test test)
+{
+    std::vector<char> good((size + 4095) / 4096, 1);
+
+    parallel_for(good.size(), 1, [&](std::size_t begin, std::size_t end) {
+        for (auto block = begin; block != end; block++)
+        {
+            auto last = std::min(block * 4096 + 4096, size);
+
+            for (auto i = block * 4096; i != last && good[block]; i++)
+                good[block] = test(i);
+        }
+    });
+
+    return std::find(good.begin(), good.end(), 0) == good.end();
+}
+
+static std::uint64_t digest(const std::pair<Face, void *> &pair)
+{
+    return mix(digest(pair.first) ^
+               std::uint64_t(reinterpret_cast<std::uintptr_t>(pair.second)));
+}
+
+// Orders the faces (idx, a, b) around idx into fans, every face followed by
+// the one starting on the edge it ends with. Sorting by a finds each
+// successor with a binary search. The v1 fields, all idx, hold the links
+// meanwhile: the successor's position above three flag bits.
+static std::size_t fans(Face *faces, std::size_t count, std::size_t *verts,
+                        std::size_t capacity, bool &boundary, bool &manifold)
+{
+    const std::size_t REACHED = 1, VISITED = 2, OPEN = 4;
+    const std::size_t NONE = std::size_t(-1) >> 3;
+    auto idx = faces[0].v1;
+
+    std::sort(faces, faces + count, [](const Face &face1, const Face &face2) {
+        return face1.v2 < face2.v2;
+    });
+
+    for (std::size_t i = 0; i != count; i++)
+    {
+        faces[i].v1 = 0;
+
+        // Two faces leaving idx along the same edge.
+        if (i != 0 && faces[i].v2 == faces[i - 1].v2)
+            manifold = false;
+    }
+
+    for (std::size_t i = 0; i != count; i++)
+    {
+        auto found = std::lower_bound(
+            faces, faces + count, faces[i].v3,
+            [](const Face &face, std::size_t v) { return face.v2 < v; });
+        auto next = found != faces + count && found->v2 == faces[i].v3
+                        ? std::size_t(found - faces)
+                        : NONE;
+        faces[i].v1 |= next << 3;
+
+        // Two faces leading into the same one.
+        if (next != NONE && faces[next].v1 & REACHED)
+            manifold = false;
+
+        if (next != NONE)
+            faces[next].v1 |= REACHED;
+    }
+
+    // Open fans are walked from the faces nothing leads into, what is left
+    // are closed fans. The walk order goes to verts while it has room.
+    std::size_t position = 0, countVerts = 0, countFans = 0;
+
+    for (int pass = 0; pass != 2; pass++)
+        for (std::size_t i = 0; i != count; i++)
+        {
+            if (faces[i].v1 & VISITED || (pass == 0 && faces[i].v1 & REACHED))
+                continue;
+
+            auto j = i, last = i;
+            countFans++;
+
+            for (; j != NONE && !(faces[j].v1 & VISITED);
+                 j = faces[j].v1 >> 3)
+            {
+                faces[j].v1 |= VISITED;
+
+                if (capacity >= count)
+                    verts[position] = j;
+
+                position++, countVerts++, last = j;
+            }
+
+            if (j != i)
+            {
+                faces[last].v1 |= OPEN;
+                boundary = true;
+                countVerts++;
+            }
+        }
+
+    // A vertex where several fans meet is pinched.
+    if (countFans > 1)
+        manifold = false;
+
+    if (capacity >= countVerts)
+    {
+        for (std::size_t p = 0; p != count; p++)
+        {
+            if (verts[p] == p)
+                continue;
+
+            auto face = faces[p];
+            auto q = p;
+
+            while (verts[q] != p)
+            {
+                auto source = verts[q];
+                faces[q] = faces[source];
+                verts[q] = q;
+                q = source;
+            }
+
+            faces[q] = face;
+            verts[q] = q;
+        }
+
+        for (std::size_t i = 0, j = 0; i != count; i++)
+        {
+            verts[j++] = faces[i].v2;
+
+            if (faces[i].v1 & OPEN)
+                verts[j++] = faces[i].v3;
+        }
+    }
+
+    for (std::size_t i = 0; i != count; i++)
+        faces[i].v1 = idx;
+
+    return countVerts;
+}
+
+Vert Verts::operator[](std::size_t idx) const
+{
+    auto found = this->verts.find(idx);
+
+    if (found == this->verts.cend())
+    {
+        auto INF = std::numeric_limits<double>::infinity();
+        return Vert(INF, INF, INF);
+    }
+    else
+        return found->second;
+}
+
+void Verts::insert(const Vert &vert)
+{
+    if (this->verts.empty())
+    {
+        this->verts[0] = vert;
+        this->hash ^= digest(0, vert);
+
+        if (this->deferred)
+            this->dirty = true;
+        else
+            this->vertsInv.insert(std::pair<Vert, std::size_t>(vert, 0));
+    }
+    else
+    {
+        auto idx = this->verts.crbegin()->first + 1;
+        this->verts[idx] = vert;
+        this->hash ^= digest(idx, vert);
+
+        if (this->deferred)
+            this->dirty = true;
+        else
+            this->vertsInv.insert(std::pair<Vert, std::size_t>(vert, idx));
+    }
+}
+
+void Verts::modify(std::size_t idx, const Vert &vert)
+{
+    auto found = this->verts.find(idx);
+
+    if (found == this->verts.cend())
+        return;
+
+    this->hash ^= digest(idx, found->second) ^ digest(idx, vert);
+
+    if (this->deferred || this->dirty)
+    {
+        found->second = vert;
+        this->dirty = true;
+        return;
+    }
+
+    auto range = this->vertsInv.equal_range(found->second);
+    auto lower = range.first, upper = range.second;
+
+    for (auto iter = lower; iter != upper; iter++)
+        if (iter->first == found->second && iter->second == idx)
+        {
+            this->vertsInv.erase(iter);
+            break;
+        }
+
+    this->vertsInv.insert(std::pair<Vert, std::size_t>(vert, idx));
+    found->second = vert;
+}
+
+void Verts::modify(const std::size_t *ptrIdx, const Vert *ptrVert,
+                   std::size_t size)
+{
+    // Past a small batch it is cheaper to rebuild the inverse index in one
+    // sorted pass than to erase and reinsert every entry. When deferred,
+    // the rebuild waits for the next query that needs it.
+    if (!this->deferred && !this->dirty && size < this->verts.size() / 16)
+    {
+        for (std::size_t i = 0; i != size; i++)
+            this->modify(ptrIdx[i], ptrVert[i]);
+
+        return;
+    }
+
+    auto hint = this->verts.end();
+
+    for (std::size_t i = 0; i != size; i++)
+    {
+        auto found = hint != this->verts.end() && hint->first == ptrIdx[i]
+                         ? hint
+                         : this->verts.find(ptrIdx[i]);
+
+        if (found == this->verts.end())
+            continue;
+
+        this->hash ^= digest(ptrIdx[i], found->second) ^
+                      digest(ptrIdx[i], ptrVert[i]);
+        found->second = ptrVert[i];
+        hint = ++found;
+    }
+
+    this->dirty = true;
+
+    if (!this->deferred)
+        this->rebuild();
+}
+
+void Verts::erase(std::size_t idx)
+{
+    auto found = this->verts.find(idx);
+
+    if (found == this->verts.cend())
+        return;
+
+    this->hash ^= digest(idx, found->second);
+
+    if (this->dirty)
+    {
+        this->verts.erase(found);
+        return;
+    }
+
+    auto range = this->vertsInv.equal_range(found->second);
+    auto lower = range.first, upper = range.second;
+
+    for (auto iter = lower; iter != upper; iter++)
+        if (iter->first == found->second && iter->second == idx)
+        {
+            this->vertsInv.erase(iter);
+            break;
+        }
+
+    this->verts.erase(found);
+}
+
+void Verts::erase(const Vert &vert)
+{
+    this->rebuild();
+
+    auto range = this->vertsInv.equal_range(vert);
+    auto lower = range.first, upper = range.second;
+
+    for (auto iter = lower; iter != upper; iter++)
+    {
+        this->hash ^= digest(iter->second, iter->first);
+        this->verts.erase(iter->second);
+    }
+
+    this->vertsInv.erase(vert);
+}
+
+void Verts::clear()
+{
+    this->verts.clear();
+    this->vertsInv.clear();
+    this->dirty = false;
+    this->hash = 0;
+}
+
+void Verts::defer(bool deferred)
+{
+    this->deferred = deferred;
+
+    if (!deferred)
+        this->rebuild();
+}
+
+void Verts::rebuild() const
+{
+    if (!this->dirty)
+        return;
+
+    std::lock_guard<std::mutex> lock(this->dirty.mutex);
+
+    if (!this->dirty)
+        return;
+
+    std::vector<std::pair<Vert, std::size_t>> vector;
+    vector.reserve(this->verts.size());
+
+    for (auto iter = this->verts.cbegin(); iter != this->verts.cend(); iter++)
+        vector.push_back(std::pair<Vert, std::size_t>(iter->second,
+                                                      iter->first));
+
+    std::sort(vector.begin(), vector.end());
+    this->vertsInv.clear();
+
+    for (std::size_t i = 0; i != vector.size(); i++)
+        this->vertsInv.insert(this->vertsInv.cend(), vector[i]);
+
+    this->dirty = false;
+}
+
+bool Verts::renumber(const std::vector<std::size_t> &map)
+{
+    if (!injective(map))
+        return false;
+
+    std::map<std::size_t, Vert> verts;
+    std::multimap<Vert, std::size_t> vertsInv;
+    std::uint64_t hash = 0;
+
+    for (auto iter = this->verts.cbegin();
+         iter != this->verts.cend(); iter++)
+        if (iter->first < map.size() && map[iter->first] != std::size_t(-1))
+        {
+            verts.insert(verts.cend(), std::pair<std::size_t, Vert>(
+                                           map[iter->first], iter->second));
+            hash ^= digest(map[iter->first], iter->second);
+        }
+
+    for (auto iter = this->vertsInv.cbegin();
+         iter != this->vertsInv.cend() && !this->dirty; iter++)
+        if (iter->second < map.size() && map[iter->second] != std::size_t(-1))
+            vertsInv.insert(vertsInv.cend(), std::pair<Vert, std::size_t>(
+                                                 iter->first, map[iter->second]));
+
+    this->verts.swap(verts);
+    this->vertsInv.swap(vertsInv);
+    this->hash = hash;
+    return true;
+}
+
+std::vector<std::size_t> Verts::compact()
+{
+    std::vector<std::size_t> map;
+
+    if (this->verts.empty())
+        return map;
+
+    map.assign(this->verts.crbegin()->first + 1, -1);
+    std::size_t idx = 0;
+
+    for (auto iter = this->verts.cbegin();
+         iter != this->verts.cend(); iter++)
+        map[iter->first] = idx++;
+
+    this->renumber(map);
+    return map;
+}
+
+std::vector<std::size_t> Verts::compact(Faces &faces, Edges &edges)
+{
+    auto map = this->compact();
+    std::thread thread(&Edges::renumber, &edges, std::cref(map));
+    faces.renumber(map);
+    thread.join();
+    return map;
+}
+
+bool Verts::defer() const
+{
+    return this->deferred;
+}
+
+std::size_t Verts::size() const
+{
+    return this->verts.size();
+}
+
+std::set<std::size_t> Verts::search(const Vert &vert) const
+{
+    this->rebuild();
+
+    std::set<std::size_t> set;
+    auto range = this->vertsInv.equal_range(vert);
+    auto lower = range.first, upper = range.second;
+
+    for (auto iter = lower; iter != upper; iter++)
+        set.insert(iter->second);
+
+    return set;
+}
+
+void Verts::search(const Vert *ptrVert, std::size_t size,
+                   std::size_t *ptrIdx) const
+{
+    this->rebuild();
+
+    auto upper = this->vertsInv.cend();
+
+    merge_join(this->vertsInv, ptrVert, size,
+               [](const std::pair<const Vert, std::size_t> &pair)
+                   -> const Vert & { return pair.first; },
+               [&](std::size_t i, decltype(upper) iter) {
+                   ptrIdx[i] = -1;
+
+                   for (; iter != upper && iter->first == ptrVert[i]; iter++)
+                       ptrIdx[i] = std::min(ptrIdx[i], iter->second);
+               });
+}
+
+void Verts::copy_all(Vert *ptr) const
+{
+    auto lower = this->verts.cbegin();
+    auto upper = this->verts.cend();
+
+    for (auto iter = lower; iter != upper; iter++)
+        *ptr++ = iter->second;
+}
+
+void Verts::copy_all(std::size_t *ptrIdx, Vert *ptrVert) const
+{
+    auto lower = this->verts.cbegin();
+    auto upper = this->verts.cend();
+
+    for (auto iter = lower; iter != upper; iter++)
+    {
+        *ptrIdx++ = iter->first;
+        *ptrVert++ = iter->second;
+    }
+}
+
+
+std::uint64_t Verts::fingerprint() const
+{
+    return this->hash;
+}
+
+bool Verts::verify() const
+{
+    std::vector<std::pair<std::size_t, Vert>> vector(this->verts.cbegin(),
+                                                     this->verts.cend());
+    std::uint64_t sum, bits, sumInv, bitsInv;
+    auto hash = [](const std::pair<std::size_t, Vert> &pair) {
+        return digest(pair.first, pair.second);
+    };
+    checksum(vector, hash, sum, bits);
+
+    if (bits != this->hash)
+        return false;
+
+    // A stale inverse index is expected until the next rebuild.
+    if (this->dirty)
+        return true;
+
+    if (this->vertsInv.size() != vector.size())
+        return false;
+
+    std::vector<std::pair<Vert, std::size_t>> inverse(this->vertsInv.cbegin(),
+                                                      this->vertsInv.cend());
+    checksum(inverse, [](const std::pair<Vert, std::size_t> &pair) {
+        return digest(pair.second, pair.first);
+    }, sumInv, bitsInv);
+
+    return sum == sumInv;
+}
+
+std::map<std::string, std::size_t> Verts::memory() const
+{
+    this->rebuild();
+
+    std::map<std::string, std::size_t> map;
+    map["verts"] = tree_size(this->verts);
+    map["vertsInv"] = tree_size(this->vertsInv);
+    return map;
+}
+
+
+void Edges::insert(Edge edge)
+{
+    if (edge.v1 == edge.v2)
+        return;
+
+    if (edge.v1 > edge.v2)
+        std::swap(edge.v1, edge.v2);
+
+    auto before = this->edgesByV1.size();
+    this->edgesByV1.insert(edge);
+
+    if (this->edgesByV1.size() > before)
+    {
+        this->edgesByV2.insert(edge);
+        this->hash ^= digest(edge);
+    }
+}
+
+void Edges::erase(std::size_t idx)
+{
+    auto lower = this->edgesByV1.lower_bound(Edge(idx, 0));
+    auto upper = this->edgesByV1.upper_bound(Edge(idx, -1));
+
+    for (auto iter = lower; iter != upper;)
+    {
+        auto range2 = this->edgesByV2.equal_range(*iter);
+        auto lower2 = range2.first, upper2 = range2.second;
+
+        for (auto iter2 = lower2; iter2 != upper2; iter2++)
+            if (*iter2 == *iter)
+            {
+                this->edgesByV2.erase(iter2);
+                break;
+            }
+
+        this->hash ^= digest(*iter);
+        this->edgesByV1.erase(iter++);
+    }
+
+    auto range = this->edgesByV2.equal_range(Edge(0, idx));
+    lower = range.first, upper = range.second;
+
+    for (auto iter = lower; iter != upper; iter++)
+    {
+        this->hash ^= digest(*iter);
+        this->edgesByV1.erase(*iter);
+    }
+
+    this->edgesByV2.erase(Edge(0, idx));
+}
+
+void Edges::erase(Edge edge)
+{
+    if (edge.v1 > edge.v2)
+        std::swap(edge.v1, edge.v2);
+
+    auto range = this->edgesByV2.equal_range(edge);
+    auto lower = range.first, upper = range.second;
+
+    for (auto iter = lower; iter != upper; iter++)
+        if (*iter == edge)
+        {
+            this->edgesByV2.erase(iter);
+            break;
+        }
+
+    if (this->edgesByV1.erase(edge) != 0)
+        this->hash ^= digest(edge);
+}
+
+void Edges::clear()
+{
+    this->edgesByV1.clear();
+    this->edgesByV2.clear();
+    this->hash = 0;
+}
+
+bool Edges::renumber(const std::vector<std::size_t> &map)
+{
+    if (!injective(map))
+        return false;
+
+    auto remap = [&map](Edge &edge) {
+        if (edge.v1 >= map.size() || edge.v2 >= map.size())
+            return false;
+
+        edge = Edge(map[edge.v1], map[edge.v2]);
+
+        if (edge.v1 == std::size_t(-1) || edge.v2 == std::size_t(-1))
+            return false;
+
+        if (edge.v1 > edge.v2)
+            std::swap(edge.v1, edge.v2);
+
+        return true;
+    };
+
+    std::set<Edge> edgesByV1;
+    std::multiset<Edge, Edge::OrderByV2> edgesByV2;
+    std::uint64_t hash = 0;
+
+    for (auto iter = this->edgesByV1.cbegin();
+         iter != this->edgesByV1.cend(); iter++)
+    {
+        auto edge = *iter;
+
+        if (remap(edge))
+        {
+            edgesByV1.insert(edgesByV1.cend(), edge);
+            hash ^= digest(edge);
+        }
+    }
+
+    for (auto iter = this->edgesByV2.cbegin();
+         iter != this->edgesByV2.cend(); iter++)
+    {
+        auto edge = *iter;
+
+        if (remap(edge))
+            edgesByV2.insert(edgesByV2.cend(), edge);
+    }
+
+    this->edgesByV1.swap(edgesByV1);
+    this->edgesByV2.swap(edgesByV2);
+    this->hash = hash;
+    return true;
+}
+
+bool Edges::find(Edge edge) const
+{
+    if (edge.v1 > edge.v2)
+        std::swap(edge.v1, edge.v2);
+
+    return this->edgesByV1.find(edge) != this->edgesByV1.cend();
+}
+
+void Edges::find(const Edge *ptrEdge, std::size_t size, bool *ptrFound) const
+{
+    std::vector<Edge> vector(ptrEdge, ptrEdge + size);
+
+    for (std::size_t i = 0; i != size; i++)
+        if (vector[i].v1 > vector[i].v2)
+            std::swap(vector[i].v1, vector[i].v2);
+
+    auto upper = this->edgesByV1.cend();
+
+    merge_join(this->edgesByV1, vector.data(), size,
+               [](const Edge &edge) -> const Edge & { return edge; },
+               [&](std::size_t i, decltype(upper) iter) {
+                   ptrFound[i] = iter != upper && *iter == vector[i];
+               });
+}
+
+std::size_t Edges::size() const
+{
+    return this->edgesByV1.size();
+}
+
+std::set<Edge> Edges::search(std::size_t idx) const
+{
+    std::set<Edge> set;
+    auto lower = this->edgesByV1.lower_bound(Edge(idx, 0));
+    auto upper = this->edgesByV1.upper_bound(Edge(idx, -1));
+
+    for (auto iter = lower; iter != upper; iter++)
+        set.insert(*iter);
+
+    auto range = this->edgesByV2.equal_range(Edge(0, idx));
+    lower = range.first, upper = range.second;
+
+    for (auto iter = lower; iter != upper; iter++)
+        set.insert(*iter);
+
+    return set;
+}
+
+void Edges::copy_all(Edge *ptr) const
+{
+    auto lower = this->edgesByV1.cbegin();
+    auto upper = this->edgesByV1.cend();
+
+    for (auto iter = lower; iter != upper; iter++)
+        *ptr++ = *iter;
+}
+
+
+std::uint64_t Edges::fingerprint() const
+{
+    return this->hash;
+}
+
+bool Edges::verify() const
+{
+    std::vector<Edge> vector(this->edgesByV1.cbegin(), this->edgesByV1.cend());
+    std::vector<Edge> vector2(this->edgesByV2.cbegin(), this->edgesByV2.cend());
+    std::uint64_t sum, bits, sum2, bits2;
+    auto hash = [](const Edge &edge) { return digest(edge); };
+
+    if (vector.size() != vector2.size())
+        return false;
+
+    checksum(vector, hash, sum, bits);
+    checksum(vector2, hash, sum2, bits2);
+
+    return bits == this->hash && sum == sum2 &&
+           all(vector.size(), [&vector](std::size_t i) {
+               return vector[i].v1 < vector[i].v2;
+           });
+}
+
+std::map<std::string, std::size_t> Edges::memory() const
+{
+    std::map<std::string, std::size_t> map;
+    map["edgesByV1"] = tree_size(this->edgesByV1);
+    map["edgesByV2"] = tree_size(this->edgesByV2);
+    return map;
+}
+
+
+void *Faces::operator[](Face face) const
+{
+    if (face.v2 < face.v3 && face.v2 < face.v1)
+        face = Face(face.v2, face.v3, face.v1);
+    else if (face.v3 < face.v1 && face.v3 < face.v2)
+        face = Face(face.v3, face.v1, face.v2);
+
+    auto found = this->facesByV1.find(face);
+
+    if (found == this->facesByV1.cend())
+        return nullptr;
+    else
+        return found->second;
+}
+
+void Faces::find(const Face *ptrFace, std::size_t size, void **ptrPtr) const
+{
+    std::vector<Face> vector(ptrFace, ptrFace + size);
+
+    for (std::size_t i = 0; i != size; i++)
+    {
+        auto &face = vector[i];
+
+        if (face.v2 < face.v3 && face.v2 < face.v1)
+            face = Face(face.v2, face.v3, face.v1);
+        else if (face.v3 < face.v1 && face.v3 < face.v2)
+            face = Face(face.v3, face.v1, face.v2);
+    }
+
+    auto upper = this->facesByV1.cend();
+
+    merge_join(this->facesByV1, vector.data(), size,
+               [](const std::pair<const Face, void *> &pair)
+                   -> const Face & { return pair.first; },
+               [&](std::size_t i, decltype(upper) iter) {
+                   ptrPtr[i] = iter != upper && iter->first == vector[i]
+                                   ? iter->second
+                                   : nullptr;
+               });
+}
+
+void Faces::insert(Face face, void *ptr)
+{
+    if (face.v1 == face.v2 || face.v2 == face.v3 || face.v3 == face.v1)
+        return;
+
+    if (face.v2 < face.v3 && face.v2 < face.v1)
+        face = Face(face.v2, face.v3, face.v1);
+    else if (face.v3 < face.v1 && face.v3 < face.v2)
+        face = Face(face.v3, face.v1, face.v2);
+
+    auto before = this->facesByV1.size();
+    this->facesByV1[face] = ptr;
+
+    if (this->facesByV1.size() > before)
+        this->hash ^= digest(face);
+
+    if (this->deferred || this->dirty)
+    {
+        this->dirty = true;
+        return;
+    }
+
+    if (this->facesByV1.size() > before)
+    {
+        this->facesByV2.insert(std::pair<Face, void *>(face, ptr));
+        this->facesByV3.insert(std::pair<Face, void *>(face, ptr));
+
+        if (this->linked)
+        {
+            Face none(-1, -1, -1);
+            this->dual[face] = {{none, none, none}};
+            this->relink(face.v1, face.v2);
+            this->relink(face.v2, face.v3);
+            this->relink(face.v3, face.v1);
+        }
+    }
+    else
+    {
+        auto range = facesByV2.equal_range(face);
+        auto lower = range.first, upper = range.second;
+
+        for (auto iter = lower; iter != upper; iter++)
+            if (iter->first == face)
+            {
+                iter->second = ptr;
+                break;
+            }
+
+        range = facesByV3.equal_range(face);
+        lower = range.first, upper = range.second;
+
+        for (auto iter = lower; iter != upper; iter++)
+            if (iter->first == face)
+            {
+                iter->second = ptr;
+                break;
+            }
+    }
+}
+
+void Faces::insert(const Face &face, void *ptr, Edges &edges)
+{
+    this->insert(face, ptr);
+    edges.insert(Edge(face.v1, face.v2));
+    edges.insert(Edge(face.v2, face.v3));
+    edges.insert(Edge(face.v3, face.v1));
+}
+
+void Faces::erase(std::size_t idx)
+{
+    this->rebuild();
+
+    auto erased = this->linked ? this->search(idx)
+                               : std::map<Face, void *>();
+
+    auto lower = this->facesByV1.lower_bound(Face(idx, 0, 0));
+    auto upper = this->facesByV1.upper_bound(Face(idx, -1, -1));
+
+    for (auto iter = lower; iter != upper;)
+    {
+        auto range2 = this->facesByV2.equal_range(iter->first);
+        auto lower2 = range2.first, upper2 = range2.second;
+
+        for (auto iter2 = lower2; iter2 != upper2; iter2++)
+            if (iter2->first == iter->first)
+            {
+                this->facesByV2.erase(iter2);
+                break;
+            }
+
+        auto range3 = this->facesByV3.equal_range(iter->first);
+        auto lower3 = range3.first, upper3 = range3.second;
+
+        for (auto iter3 = lower3; iter3 != upper3; iter3++)
+            if (iter3->first == iter->first)
+            {
+                this->facesByV3.erase(iter3);
+                break;
+            }
+
+        this->hash ^= digest(iter->first);
+        this->facesByV1.erase(iter++);
+    }
+
+    auto range = this->facesByV2.equal_range(Face(0, idx, 0));
+    lower = range.first, upper = range.second;
+
+    for (auto iter = lower; iter != upper; iter++)
+    {
+        auto range3 = this->facesByV3.equal_range(iter->first);
+        auto lower3 = range3.first, upper3 = range3.second;
+
+        for (auto iter3 = lower3; iter3 != upper3; iter3++)
+            if (iter3->first == iter->first)
+            {
+                this->facesByV3.erase(iter3);
+                break;
+            }
+
+        this->hash ^= digest(iter->first);
+        this->facesByV1.erase(iter->first);
+    }
+
+    range = this->facesByV3.equal_range(Face(0, 0, idx));
+    lower = range.first, upper = range.second;
+
+    for (auto iter = lower; iter != upper; iter++)
+    {
+        auto range2 = this->facesByV2.equal_range(iter->first);
+        auto lower2 = range2.first, upper2 = range2.second;
+
+        for (auto iter2 = lower2; iter2 != upper2; iter2++)
+            if (iter2->first == iter->first)
+            {
+                this->facesByV2.erase(iter2);
+                break;
+            }
+
+        this->hash ^= digest(iter->first);
+        this->facesByV1.erase(iter->first);
+    }
+
+    this->facesByV2.erase(Face(0, idx, 0));
+    this->facesByV3.erase(Face(0, 0, idx));
+    this->unlink(erased);
+}
+
+void Faces::erase(std::size_t idx, Edges &edges)
+{
+    this->erase(idx);
+    edges.erase(idx);
+}
+
+void Faces::erase(const Edge &edge)
+{
+    this->rebuild();
+
+    auto erased = this->linked ? this->search(edge)
+                               : std::map<Face, void *>();
+
+    auto lower = this->facesByV1.lower_bound(Face(edge.v1, 0, 0));
+    auto upper = this->facesByV1.upper_bound(Face(edge.v1, -1, -1));
+
+    for (auto iter = lower; iter != upper;)
+        if (iter->first.v2 == edge.v2 || iter->first.v3 == edge.v2)
+        {
+            auto range2 = this->facesByV2.equal_range(iter->first);
+            auto lower2 = range2.first, upper2 = range2.second;
+
+            for (auto iter2 = lower2; iter2 != upper2; iter2++)
+                if (iter2->first == iter->first)
+                {
+                    this->facesByV2.erase(iter2);
+                    break;
+                }
+
+            auto range3 = this->facesByV3.equal_range(iter->first);
+            auto lower3 = range3.first, upper3 = range3.second;
+
+            for (auto iter3 = lower3; iter3 != upper3; iter3++)
+                if (iter3->first == iter->first)
+                {
+                    this->facesByV3.erase(iter3);
+                    break;
+                }
+
+            this->hash ^= digest(iter->first);
+            this->facesByV1.erase(iter++);
+        }
+        else
+            iter++;
+
+    lower = this->facesByV1.lower_bound(Face(edge.v2, 0, 0));
+    upper = this->facesByV1.upper_bound(Face(edge.v2, -1, -1));
+
+    for (auto iter = lower; iter != upper;)
+        if (iter->first.v2 == edge.v1 || iter->first.v3 == edge.v1)
+        {
+            auto range2 = this->facesByV2.equal_range(iter->first);
+            auto lower2 = range2.first, upper2 = range2.second;
+
+            for (auto iter2 = lower2; iter2 != upper2; iter2++)
+                if (iter2->first == iter->first)
+                {
+                    this->facesByV2.erase(iter2);
+                    break;
+                }
+
+            auto range3 = this->facesByV3.equal_range(iter->first);
+            auto lower3 = range3.first, upper3 = range3.second;
+
+            for (auto iter3 = lower3; iter3 != upper3; iter3++)
+                if (iter3->first == iter->first)
+                {
+                    this->facesByV3.erase(iter3);
+                    break;
+                }
+
+            this->hash ^= digest(iter->first);
+            this->facesByV1.erase(iter++);
+        }
+        else
+            iter++;
+
+    auto range = this->facesByV2.equal_range(Face(0, edge.v1, 0));
+    lower = range.first, upper = range.second;
+
+    for (auto iter = lower; iter != upper;)
+        if (iter->first.v3 == edge.v2)
+        {
+            auto range3 = this->facesByV3.equal_range(iter->first);
+            auto lower3 = range3.first, upper3 = range3.second;
+
+            for (auto iter3 = lower3; iter3 != upper3; iter3++)
+                if (iter3->first == iter->first)
+                {
+                    this->facesByV3.erase(iter3);
+                    break;
+                }
+
+            this->hash ^= digest(iter->first);
+            this->facesByV1.erase(iter->first);
+            this->facesByV2.erase(iter++);
+        }
+        else
+            iter++;
+
+    range = this->facesByV2.equal_range(Face(0, edge.v2, 0));
+    lower = range.first, upper = range.second;
+
+    for (auto iter = lower; iter != upper;)
+        if (iter->first.v3 == edge.v1)
+        {
+            auto range3 = this->facesByV3.equal_range(iter->first);
+            auto lower3 = range3.first, upper3 = range3.second;
+
+            for (auto iter3 = lower3; iter3 != upper3; iter3++)
+                if (iter3->first == iter->first)
+                {
+                    this->facesByV3.erase(iter3);
+                    break;
+                }
+
+            this->hash ^= digest(iter->first);
+            this->facesByV1.erase(iter->first);
+            this->facesByV2.erase(iter++);
+        }
+        else
+            iter++;
+
+    this->unlink(erased);
+}
+
+void Faces::erase(const Edge &edge, Edges &edges)
+{
+    this->erase(edge);
+    edges.erase(edge);
+}
+
+void Faces::erase(Face face)
+{
+    if (face.v2 < face.v3 && face.v2 < face.v1)
+        face = Face(face.v2, face.v3, face.v1);
+    else if (face.v3 < face.v1 && face.v3 < face.v2)
+        face = Face(face.v3, face.v1, face.v2);
+
+    auto found = this->facesByV1.find(face);
+
+    if (found == this->facesByV1.cend())
+        return;
+
+    this->hash ^= digest(face);
+
+    if (this->dirty)
+    {
+        this->facesByV1.erase(found);
+        return;
+    }
+
+    auto erased = this->linked ? std::map<Face, void *>(found, std::next(found))
+                               : std::map<Face, void *>();
+
+    auto range = facesByV2.equal_range(face);
+    auto lower = range.first, upper = range.second;
+
+    for (auto iter = lower; iter != upper; iter++)
+        if (iter->first == face)
+        {
+            this->facesByV2.erase(iter);
+            break;
+        }
+
+    range = facesByV3.equal_range(face);
+    lower = range.first, upper = range.second;
+
+    for (auto iter = lower; iter != upper; iter++)
+        if (iter->first == face)
+        {
+            this->facesByV3.erase(iter);
+            break;
+        }
+
+    this->facesByV1.erase(found);
+    this->unlink(erased);
+}
+
+void Faces::erase(const Face &face, Edges &edges)
+{
+    this->erase(face);
+
+    if (this->search(Edge(face.v1, face.v2)).empty())
+        edges.erase(Edge(face.v1, face.v2));
+
+    if (this->search(Edge(face.v2, face.v3)).empty())
+        edges.erase(Edge(face.v2, face.v3));
+
+    if (this->search(Edge(face.v3, face.v1)).empty())
+        edges.erase(Edge(face.v3, face.v1));
+}
+
+void Faces::clear()
+{
+    this->facesByV1.clear();
+    this->facesByV2.clear();
+    this->facesByV3.clear();
+    this->dual.clear();
+    this->dirty = false;
+    this->hash = 0;
+}
+
+void Faces::defer(bool deferred)
+{
+    this->deferred = deferred;
+
+    if (!deferred)
+        this->rebuild();
+}
+
+void Faces::adjacency(bool linked)
+{
+    this->linked = linked;
+
+    if (linked && !this->dirty)
+        this->relink();
+    else if (!linked)
+        this->dual.clear();
+}
+
+void Faces::rebuild() const
+{
+    if (!this->dirty)
+        return;
+
+    std::lock_guard<std::mutex> lock(this->dirty.mutex);
+
+    if (!this->dirty)
+        return;
+
+    // Both secondary indexes are rebuilt from a stable sort of the primary
+    // one, each on its own thread, with end-hinted inserts.
+    std::vector<std::pair<Face, void *>> vector2(this->facesByV1.cbegin(),
+                                                 this->facesByV1.cend());
+    auto vector3 = vector2;
+
+    std::thread thread([&]() {
+        std::stable_sort(vector2.begin(), vector2.end(),
+                         [](const std::pair<Face, void *> &pair1,
+                            const std::pair<Face, void *> &pair2) {
+                             return pair1.first.v2 < pair2.first.v2;
+                         });
+        this->facesByV2.clear();
+
+        for (std::size_t i = 0; i != vector2.size(); i++)
+            this->facesByV2.insert(this->facesByV2.cend(), vector2[i]);
+    });
+
+    std::stable_sort(vector3.begin(), vector3.end(),
+                     [](const std::pair<Face, void *> &pair1,
+                        const std::pair<Face, void *> &pair2) {
+                         return pair1.first.v3 < pair2.first.v3;
+                     });
+    this->facesByV3.clear();
+
+    for (std::size_t i = 0; i != vector3.size(); i++)
+        this->facesByV3.insert(this->facesByV3.cend(), vector3[i]);
+
+    thread.join();
+
+    // The dual graph is rebuilt before the flag clears, so const calls
+    // never read it half built.
+    if (this->linked)
+        this->relink();
+
+    this->dirty = false;
+}
+
+// Builds the dual graph from scratch: every face contributes three half
+// edges, and after sorting them an edge shared by exactly two faces links
+// them. Boundary and non-manifold edges keep the sentinel.
+void Faces::relink() const
+{
+    std::vector<Face> faces;
+    faces.reserve(this->facesByV1.size());
+
+    for (auto iter = this->facesByV1.cbegin();
+         iter != this->facesByV1.cend(); iter++)
+        faces.push_back(iter->first);
+
+    std::vector<std::pair<Edge, std::size_t>> halves(3 * faces.size());
+
+    parallel_for(faces.size(), 4096, [&](std::size_t begin, std::size_t end) {
+        for (auto i = begin; i != end; i++)
+        {
+            std::size_t corners[3] = {faces[i].v1, faces[i].v2, faces[i].v3};
+
+            for (std::size_t j = 0; j != 3; j++)
+            {
+                Edge edge(corners[j], corners[(j + 1) % 3]);
+
+                if (edge.v1 > edge.v2)
+                    std::swap(edge.v1, edge.v2);
+
+                halves[3 * i + j] = std::pair<Edge, std::size_t>(edge,
+                                                                 3 * i + j);
+            }
+        }
+    });
+
+    std::sort(halves.begin(), halves.end());
+
+    Face none(-1, -1, -1);
+    std::vector<std::array<Face, 3>> slots(faces.size(),
+                                           {{none, none, none}});
+    auto size = halves.size();
+    auto same = [&halves](std::size_t i, std::size_t j) {
+        return halves[i].first == halves[j].first;
+    };
+
+    parallel_for(size, 4096, [&](std::size_t begin, std::size_t end) {
+        for (auto i = begin; i != end; i++)
+        {
+            auto next = i + 1 < size && same(i, i + 1);
+            auto prev = i > 0 && same(i - 1, i);
+
+            if (next && !prev && !(i + 2 < size && same(i + 1, i + 2)))
+                slots[halves[i].second / 3][halves[i].second % 3] =
+                    faces[halves[i + 1].second / 3];
+            else if (prev && !next && !(i > 1 && same(i - 2, i - 1)))
+                slots[halves[i].second / 3][halves[i].second % 3] =
+                    faces[halves[i - 1].second / 3];
+        }
+    });
+
+    this->dual.clear();
+
+    for (std::size_t i = 0; i != faces.size(); i++)
+        this->dual.insert(this->dual.cend(),
+                          std::pair<Face, std::array<Face, 3>>(faces[i],
+                                                               slots[i]));
+}
+
+// Brings the slots of the faces around one edge up to date after a face
+// on it was inserted or erased. Past three faces the edge was already
+// non-manifold, so nothing changes.
+void Faces::relink(std::size_t v1, std::size_t v2)
+{
+    Face found[3];
+    auto count = this->across(v1, v2, found);
+
+    if (count > 3)
+        return;
+
+    for (std::size_t i = 0; i != count; i++)
+    {
+        auto &slots = this->dual[found[i]];
+        std::size_t corners[3] = {found[i].v1, found[i].v2, found[i].v3};
+
+        for (std::size_t j = 0; j != 3; j++)
+            if ((corners[j] == v1 && corners[(j + 1) % 3] == v2) ||
+                (corners[j] == v2 && corners[(j + 1) % 3] == v1))
+                slots[j] = count == 2 ? found[1 - i] : Face(-1, -1, -1);
+    }
+}
+
+void Faces::unlink(const std::map<Face, void *> &erased)
+{
+    for (auto iter = erased.cbegin(); iter != erased.cend(); iter++)
+        this->dual.erase(iter->first);
+
+    for (auto iter = erased.cbegin(); iter != erased.cend(); iter++)
+    {
+        this->relink(iter->first.v1, iter->first.v2);
+        this->relink(iter->first.v2, iter->first.v3);
+        this->relink(iter->first.v3, iter->first.v1);
+    }
+}
+
+// Counts the faces on an edge without building a map, keeping the first
+// three of them.
+std::size_t Faces::across(std::size_t v1, std::size_t v2, Face *found) const
+{
+    std::size_t count = 0;
+    auto keep = [&count, found](const Face &face) {
+        if (count < 3)
+            found[count] = face;
+
+        count++;
+    };
+
+    auto lower = this->facesByV1.lower_bound(Face(v1, 0, 0));
+    auto upper = this->facesByV1.upper_bound(Face(v1, -1, -1));
+
+    for (auto iter = lower; iter != upper; iter++)
+        if (iter->first.v2 == v2 || iter->first.v3 == v2)
+            keep(iter->first);
+
+    lower = this->facesByV1.lower_bound(Face(v2, 0, 0));
+    upper = this->facesByV1.upper_bound(Face(v2, -1, -1));
+
+    for (auto iter = lower; iter != upper; iter++)
+        if (iter->first.v2 == v1 || iter->first.v3 == v1)
+            keep(iter->first);
+
+    auto range = this->facesByV2.equal_range(Face(0, v1, 0));
+
+    for (auto iter = range.first; iter != range.second; iter++)
+        if (iter->first.v3 == v2)
+            keep(iter->first);
+
+    range = this->facesByV2.equal_range(Face(0, v2, 0));
+
+    for (auto iter = range.first; iter != range.second; iter++)
+        if (iter->first.v3 == v1)
+            keep(iter->first);
+
+    return count;
+}
+
+bool Faces::renumber(const std::vector<std::size_t> &map)
+{
+    if (!injective(map))
+        return false;
+
+    auto remap = [&map](Face &face) {
+        if (face.v1 >= map.size() || face.v2 >= map.size() ||
+            face.v3 >= map.size())
+            return false;
+
+        face = Face(map[face.v1], map[face.v2], map[face.v3]);
+
+        if (face.v1 == std::size_t(-1) || face.v2 == std::size_t(-1) ||
+            face.v3 == std::size_t(-1))
+            return false;
+
+        if (face.v2 < face.v3 && face.v2 < face.v1)
+            face = Face(face.v2, face.v3, face.v1);
+        else if (face.v3 < face.v1 && face.v3 < face.v2)
+            face = Face(face.v3, face.v1, face.v2);
+
+        return true;
+    };
+
+    // A monotonic map keeps every index in its current order, so each
+    // index is rebuilt from its own ordering with end-hinted inserts.
+    std::map<Face, void *> facesByV1;
+    std::multimap<Face, void *, Face::OrderByV2> facesByV2;
+    std::multimap<Face, void *, Face::OrderByV3> facesByV3;
+
+    // Stale secondary indexes are skipped, they are rebuilt on demand.
+    std::thread thread2([&]() {
+        for (auto iter = this->facesByV2.cbegin();
+             iter != this->facesByV2.cend() && !this->dirty; iter++)
+        {
+            auto face = iter->first;
+
+            if (remap(face))
+                facesByV2.insert(facesByV2.cend(),
+                                 std::pair<Face, void *>(face, iter->second));
+        }
+    });
+    std::thread thread3([&]() {
+        for (auto iter = this->facesByV3.cbegin();
+             iter != this->facesByV3.cend() && !this->dirty; iter++)
+        {
+            auto face = iter->first;
+
+            if (remap(face))
+                facesByV3.insert(facesByV3.cend(),
+                                 std::pair<Face, void *>(face, iter->second));
+        }
+    });
+
+    std::uint64_t hash = 0;
+
+    for (auto iter = this->facesByV1.cbegin();
+         iter != this->facesByV1.cend(); iter++)
+    {
+        auto face = iter->first;
+
+        if (remap(face))
+        {
+            facesByV1.insert(facesByV1.cend(),
+                             std::pair<Face, void *>(face, iter->second));
+            hash ^= digest(face);
+        }
+    }
+
+    thread2.join();
+    thread3.join();
+    this->facesByV1.swap(facesByV1);
+    this->facesByV2.swap(facesByV2);
+    this->facesByV3.swap(facesByV3);
+    this->hash = hash;
+
+    if (this->linked && !this->dirty)
+        this->relink();
+    return true;
+}
+
+bool Faces::defer() const
+{
+    return this->deferred;
+}
+
+std::size_t Faces::size() const
+{
+    return this->facesByV1.size();
+}
+
+std::map<Face, void *> Faces::search(std::size_t idx) const
+{
+    this->rebuild();
+
+    std::map<Face, void *> map;
+    auto lower = this->facesByV1.lower_bound(Face(idx, 0, 0));
+    auto upper = this->facesByV1.upper_bound(Face(idx, -1, -1));
+
+    for (auto iter = lower; iter != upper; iter++)
+        map[iter->first] = iter->second;
+
+    auto range = this->facesByV2.equal_range(Face(0, idx, 0));
+    lower = range.first, upper = range.second;
+
+    for (auto iter = lower; iter != upper; iter++)
+        map[iter->first] = iter->second;
+
+    range = this->facesByV3.equal_range(Face(0, 0, idx));
+    lower = range.first, upper = range.second;
+
+    for (auto iter = lower; iter != upper; iter++)
+        map[iter->first] = iter->second;
+
+    return map;
+}
+
+std::map<Face, void *> Faces::search(const Edge &edge) const
+{
+    this->rebuild();
+
+    std::map<Face, void *> map;
+    auto lower = this->facesByV1.lower_bound(Face(edge.v1, 0, 0));
+    auto upper = this->facesByV1.upper_bound(Face(edge.v1, -1, -1));
+
+    for (auto iter = lower; iter != upper; iter++)
+        if (iter->first.v2 == edge.v2 || iter->first.v3 == edge.v2)
+            map[iter->first] = iter->second;
+
+    lower = this->facesByV1.lower_bound(Face(edge.v2, 0, 0));
+    upper = this->facesByV1.upper_bound(Face(edge.v2, -1, -1));
+
+    for (auto iter = lower; iter != upper; iter++)
+        if (iter->first.v2 == edge.v1 || iter->first.v3 == edge.v1)
+            map[iter->first] = iter->second;
+
+    auto range = this->facesByV2.equal_range(Face(0, edge.v1, 0));
+    lower = range.first, upper = range.second;
+
+    for (auto iter = lower; iter != upper; iter++)
+        if (iter->first.v3 == edge.v2)
+            map[iter->first] = iter->second;
+
+    range = this->facesByV2.equal_range(Face(0, edge.v2, 0));
+    lower = range.first, upper = range.second;
+
+    for (auto iter = lower; iter != upper; iter++)
+        if (iter->first.v3 == edge.v1)
+            map[iter->first] = iter->second;
+
+    return map;
+}
+
+bool Faces::ring(std::size_t idx, Face *faces, std::size_t &countFaces,
+                 std::size_t *verts, std::size_t &countVerts,
+                 bool &manifold) const
+{
+    this->rebuild();
+
+    // Incident faces are rotated to (idx, a, b), so the face following
+    // (idx, a, b) around the vertex is the one starting with (idx, b).
+    auto gather = [this, idx](Face *ptr, std::size_t capacity) {
+        std::size_t count = 0;
+        auto lower = this->facesByV1.lower_bound(Face(idx, 0, 0));
+        auto upper = this->facesByV1.upper_bound(Face(idx, -1, -1));
+
+        for (auto iter = lower; iter != upper; iter++, count++)
+            if (count < capacity)
+                ptr[count] = iter->first;
+
+        auto range2 = this->facesByV2.equal_range(Face(0, idx, 0));
+
+        for (auto iter = range2.first; iter != range2.second; iter++, count++)
+            if (count < capacity)
+                ptr[count] = Face(idx, iter->first.v3, iter->first.v1);
+
+        auto range3 = this->facesByV3.equal_range(Face(0, 0, idx));
+
+        for (auto iter = range3.first; iter != range3.second; iter++, count++)
+            if (count < capacity)
+                ptr[count] = Face(idx, iter->first.v1, iter->first.v2);
+
+        return count;
+    };
+
+    auto capacityFaces = countFaces, capacityVerts = countVerts;
+    bool boundary = false;
+    manifold = true;
+    countFaces = gather(faces, capacityFaces);
+    countVerts = 0;
+
+    if (countFaces == 0)
+        return false;
+
+    // Too small to order in place, so a scratch copy sizes the vertices.
+    if (countFaces > capacityFaces)
+    {
+        std::vector<Face> vector(countFaces);
+        gather(&vector[0], countFaces);
+        countVerts = fans(&vector[0], countFaces, verts, 0,
+                          boundary, manifold);
+        return boundary;
+    }
+
+    countVerts = fans(faces, countFaces, verts, capacityVerts,
+                      boundary, manifold);
+    return boundary;
+}
+
+bool Faces::neighbors(Face face, Face *ptr) const
+{
+    if (face.v2 < face.v3 && face.v2 < face.v1)
+        face = Face(face.v2, face.v3, face.v1);
+    else if (face.v3 < face.v1 && face.v3 < face.v2)
+        face = Face(face.v3, face.v1, face.v2);
+
+    this->rebuild();
+
+    if (this->linked)
+    {
+        auto found = this->dual.find(face);
+
+        if (found == this->dual.cend())
+            return false;
+
+        for (std::size_t i = 0; i != 3; i++)
+            ptr[i] = found->second[i];
+
+        return true;
+    }
+
+    if (this->facesByV1.find(face) == this->facesByV1.cend())
+        return false;
+
+    std::size_t corners[3] = {face.v1, face.v2, face.v3};
+
+    for (std::size_t i = 0; i != 3; i++)
+    {
+        Face found[3];
+        auto count = this->across(corners[i], corners[(i + 1) % 3], found);
+
+        if (count == 2)
+            ptr[i] = found[0] == face ? found[1] : found[0];
+        else
+            ptr[i] = Face(-1, -1, -1);
+    }
+
+    return true;
+}
+
+void Faces::sync(Edges &edges) const
+{
+    edges.clear();
+    auto lower = this->facesByV1.cbegin();
+    auto upper = this->facesByV1.cend();
+
+    for (auto iter = lower; iter != upper; iter++)
+    {
+        edges.insert(Edge(iter->first.v1, iter->first.v2));
+        edges.insert(Edge(iter->first.v2, iter->first.v3));
+        edges.insert(Edge(iter->first.v3, iter->first.v1));
+    }
+}
+
+void Faces::copy_all(Face *ptrFace, void **ptrPtr) const
+{
+    auto lower = this->facesByV1.cbegin();
+    auto upper = this->facesByV1.cend();
+
+    for (auto iter = lower; iter != upper; iter++)
+    {
+        *ptrFace++ = iter->first;
+        *ptrPtr++ = iter->second;
+    }
+}
+
+std::uint64_t Faces::fingerprint() const
+{
+    return this->hash;
+}
+
+bool Faces::verify() const
+{
+    std::vector<std::pair<Face, void *>> vector(this->facesByV1.cbegin(),
+                                                this->facesByV1.cend());
+    std::uint64_t sum, bits, sum2, bits2, sum3, bits3;
+    auto hash = [](const std::pair<Face, void *> &pair) {
+        return digest(pair);
+    };
+    checksum(vector, hash, sum, bits);
+
+    std::uint64_t unused, fingerprint;
+    checksum(vector, [](const std::pair<Face, void *> &pair) {
+        return digest(pair.first);
+    }, unused, fingerprint);
+
+    // Faces start at their smallest vertex and have 3 distinct ones.
+    if (fingerprint != this->hash ||
+        !all(vector.size(), [&vector](std::size_t i) {
+            auto face = vector[i].first;
+            return face.v1 < face.v2 && face.v1 < face.v3 &&
+                   face.v2 != face.v3;
+        }))
+        return false;
+
+    if (this->dirty)
+        return true;
+
+    if (this->facesByV2.size() != vector.size() ||
+        this->facesByV3.size() != vector.size())
+        return false;
+
+    std::vector<std::pair<Face, void *>> vector2(this->facesByV2.cbegin(),
+                                                 this->facesByV2.cend());
+    std::vector<std::pair<Face, void *>> vector3(this->facesByV3.cbegin(),
+                                                 this->facesByV3.cend());
+    checksum(vector2, hash, sum2, bits2);
+    checksum(vector3, hash, sum3, bits3);
+
+    if (sum != sum2 || sum != sum3)
+        return false;
+
+    if (!this->linked)
+        return true;
+
+    if (this->dual.size() != vector.size())
+        return false;
+
+    std::vector<std::pair<Face, std::array<Face, 3>>> dual(this->dual.cbegin(),
+                                                           this->dual.cend());
+
+    return all(dual.size(), [&](std::size_t i) {
+        auto face = dual[i].first;
+
+        if (!(face == vector[i].first))
+            return false;
+
+        std::size_t corners[3] = {face.v1, face.v2, face.v3};
+
+        for (std::size_t j = 0; j != 3; j++)
+        {
+            Face found[3];
+            auto count = this->across(corners[j], corners[(j + 1) % 3], found);
+            auto expected = count != 2           ? Face(-1, -1, -1)
+                            : found[0] == face ? found[1]
+                                               : found[0];
+
+            if (!(dual[i].second[j] == expected))
+                return false;
+        }
+
+        return true;
+    });
+}
+
+bool Faces::verify(const Verts &verts) const
+{
+    if (!this->verify())
+        return false;
+
+    std::vector<std::size_t> vectorIdx(verts.size());
+    std::vector<Vert> vectorVerts(verts.size());
+
+    if (!vectorIdx.empty())
+        verts.copy_all(&vectorIdx[0], &vectorVerts[0]);
+
+    std::vector<char> alive(vectorIdx.empty() ? 0 : vectorIdx.back() + 1, 0);
+
+    for (std::size_t i = 0; i != vectorIdx.size(); i++)
+        alive[vectorIdx[i]] = 1;
+
+    std::vector<Face> vector(this->facesByV1.size());
+    std::vector<void *> vectorPtr(this->facesByV1.size());
+
+    if (!vector.empty())
+        this->copy_all(&vector[0], &vectorPtr[0]);
+
+    return all(vector.size(), [&](std::size_t i) {
+        return std::max(vector[i].v2, vector[i].v3) < alive.size() &&
+               alive[vector[i].v1] && alive[vector[i].v2] &&
+               alive[vector[i].v3];
+    });
+}
+
+std::map<std::string, std::size_t> Faces::memory() const
+{
+    this->rebuild();
+
+    std::map<std::string, std::size_t> map;
+    map["facesByV1"] = tree_size(this->facesByV1);
+    map["facesByV2"] = tree_size(this->facesByV2);
+    map["facesByV3"] = tree_size(this->facesByV3);
+    map["dual"] = tree_size(this->dual);
+    return map;
+}
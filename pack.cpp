@@ -0,0 +1,670 @@
+#include "pack.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+
+// Records are sorted and cut into blocks of BLOCK. The first record of a
+// block is kept whole in heads, so a binary search finds the block, and
+// the rest are varint coded as differences to the record before them.
+static const std::size_t BLOCK = 64;
+
+static void put(std::vector<unsigned char> &bytes, std::uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        bytes.push_back(static_cast<unsigned char>(value | 0x80));
+        value >>= 7;
+    }
+
+    bytes.push_back(static_cast<unsigned char>(value));
+}
+
+static std::uint64_t get(const unsigned char *&ptr)
+{
+    std::uint64_t value = 0;
+
+    for (int shift = 0;; shift += 7)
+    {
+        auto byte = *ptr++;
+        value |= std::uint64_t(byte & 0x7f) << shift;
+
+        if (byte < 0x80)
+            return value;
+    }
+}
+
+static std::uint64_t zigzag(std::uint64_t value)
+{
+    return (value << 1) ^ (0 - (value >> 63));
+}
+
+static std::uint64_t unzigzag(std::uint64_t value)
+{
+    return (value >> 1) ^ (0 - (value & 1));
+}
+
+static void put(std::vector<unsigned char> &bytes, const Edge &prev,
+                const Edge &edge)
+{
+    put(bytes, edge.v1 - prev.v1);
+    put(bytes, edge.v1 == prev.v1 ? edge.v2 - prev.v2 : edge.v2 - edge.v1);
+}
+
+static Edge get(const unsigned char *&ptr, const Edge &prev)
+{
+    Edge edge;
+    edge.v1 = prev.v1 + get(ptr);
+    edge.v2 = (edge.v1 == prev.v1 ? prev.v2 : edge.v1) + get(ptr);
+    return edge;
+}
+
+static void put(std::vector<unsigned char> &bytes, const Face &prev,
+                const Face &face)
+{
+    put(bytes, face.v1 - prev.v1);
+
+    if (face.v1 == prev.v1)
+    {
+        put(bytes, face.v2 - prev.v2);
+        put(bytes, zigzag(face.v3 - face.v2));
+    }
+    else
+    {
+        put(bytes, face.v2 - face.v1);
+        put(bytes, face.v3 - face.v1);
+    }
+}
+
+static Face get(const unsigned char *&ptr, const Face &prev)
+{
+    Face face;
+    face.v1 = prev.v1 + get(ptr);
+
+    if (face.v1 == prev.v1)
+    {
+        face.v2 = prev.v2 + get(ptr);
+        face.v3 = face.v2 + unzigzag(get(ptr));
+    }
+    else
+    {
+        face.v2 = face.v1 + get(ptr);
+        face.v3 = face.v1 + get(ptr);
+    }
+
+    return face;
+}
+
+// Encodes records sorted by their first vertex into heads and blocks,
+// every block on its own so that the blocks can be coded in parallel.
+template <typename Record>
+static void encode(const std::vector<Record> &records,
+                   std::vector<Record> &heads,
+                   std::vector<std::size_t> &offsets,
+                   std::vector<unsigned char> &bytes)
+{
+    auto blocks = (records.size() + BLOCK - 1) / BLOCK;
+    std::vector<std::vector<unsigned char>> coded(blocks);
+    heads.resize(blocks);
+    offsets.assign(blocks + 1, 0);
+
+    parallel_for(blocks, 64, [&](std::size_t begin, std::size_t end) {
+        for (auto block = begin; block != end; block++)
+        {
+            auto first = block * BLOCK;
+            auto last = std::min(first + BLOCK, records.size());
+            heads[block] = records[first];
+
+            for (auto i = first + 1; i < last; i++)
+                put(coded[block], records[i - 1], records[i]);
+        }
+    });
+
+    for (std::size_t i = 0; i != blocks; i++)
+        offsets[i + 1] = offsets[i] + coded[i].size();
+
+    bytes.resize(offsets[blocks]);
+
+    parallel_for(blocks, 64, [&](std::size_t begin, std::size_t end) {
+        for (auto block = begin; block != end; block++)
+            std::copy(coded[block].begin(), coded[block].end(),
+                      bytes.begin() + offsets[block]);
+    });
+
+    bytes.shrink_to_fit();
+}
+
+template <typename Record>
+static std::vector<Record> decode_all(const std::vector<Record> &heads,
+                                      const std::vector<std::size_t> &offsets,
+                                      const std::vector<unsigned char> &bytes,
+                                      std::size_t count)
+{
+    std::vector<Record> records(count);
+
+    parallel_for(heads.size(), 64, [&](std::size_t begin, std::size_t end) {
+        for (auto block = begin; block != end; block++)
+        {
+            auto first = block * BLOCK;
+            auto last = std::min(first + BLOCK, count);
+            auto ptr = bytes.data() + offsets[block];
+            records[first] = heads[block];
+
+            for (auto i = first + 1; i < last; i++)
+                records[i] = get(ptr, records[i - 1]);
+        }
+    });
+
+    return records;
+}
+
+// For every vertex, the positions of the records that hold it anywhere
+// but first, as a count and ascending differences. Vertices are grouped
+// in blocks of BLOCK with one byte offset per group.
+static void index(const std::vector<std::vector<std::size_t>> &lists,
+                  std::vector<std::size_t> &offsets,
+                  std::vector<unsigned char> &bytes)
+{
+    offsets.assign((lists.size() + BLOCK - 1) / BLOCK, 0);
+    bytes.clear();
+
+    for (std::size_t v = 0; v != lists.size(); v++)
+    {
+        if (v % BLOCK == 0)
+            offsets[v / BLOCK] = bytes.size();
+
+        put(bytes, lists[v].size());
+        std::size_t prev = 0;
+
+        for (std::size_t i = 0; i != lists[v].size(); i++)
+        {
+            put(bytes, lists[v][i] - prev);
+            prev = lists[v][i];
+        }
+    }
+
+    bytes.shrink_to_fit();
+}
+
+static std::vector<std::size_t> lookup(const std::vector<std::size_t> &offsets,
+                                       const std::vector<unsigned char> &bytes,
+                                       std::size_t idx)
+{
+    std::vector<std::size_t> list;
+
+    if (idx / BLOCK >= offsets.size())
+        return list;
+
+    auto ptr = bytes.data() + offsets[idx / BLOCK];
+    auto stop = bytes.data() + bytes.size();
+
+    for (auto v = idx / BLOCK * BLOCK; v != idx; v++)
+    {
+        if (ptr == stop)
+            return list;
+
+        auto size = get(ptr);
+
+        for (std::size_t i = 0; i != size; i++)
+            get(ptr);
+    }
+
+    if (ptr == stop)
+        return list;
+
+    auto size = get(ptr);
+    std::size_t prev = 0;
+
+    for (std::size_t i = 0; i != size; i++)
+    {
+        prev += get(ptr);
+        list.push_back(prev);
+    }
+
+    return list;
+}
+
+template <typename Record>
+static std::size_t locate(const std::vector<Record> &heads,
+                          const Record &record)
+{
+    auto found = std::upper_bound(heads.begin(), heads.end(), record);
+    return found == heads.begin() ? heads.size() : found - heads.begin() - 1;
+}
+
+
+// Coordinates are kept either as floats or as 16 bit steps across the
+// bounding box, in index order. Indices are only stored when they have
+// gaps, otherwise the position in the arrays is the index.
+Vert PackedVerts::decode(std::size_t i) const
+{
+    if (!this->floats.empty())
+        return Vert(this->floats[3 * i], this->floats[3 * i + 1],
+                    this->floats[3 * i + 2]);
+    else
+        return Vert(this->lower.x + this->step.x * this->quants[3 * i],
+                    this->lower.y + this->step.y * this->quants[3 * i + 1],
+                    this->lower.z + this->step.z * this->quants[3 * i + 2]);
+}
+
+bool PackedVerts::pack(const Verts &verts, bool quantize)
+{
+    this->count = verts.size();
+    this->idx.resize(this->count);
+    std::vector<Vert> vector(this->count);
+
+    if (this->count != 0)
+        verts.copy_all(&this->idx[0], &vector[0]);
+
+    this->dense = this->count == 0 || this->idx.back() + 1 == this->count;
+
+    if (this->dense)
+        std::vector<std::size_t>().swap(this->idx);
+
+    auto INF = std::numeric_limits<double>::infinity();
+    this->lower = Vert(INF, INF, INF);
+    Vert upper(-INF, -INF, -INF);
+
+    for (std::size_t i = 0; i != this->count && quantize; i++)
+    {
+        this->lower.x = std::min(this->lower.x, vector[i].x);
+        this->lower.y = std::min(this->lower.y, vector[i].y);
+        this->lower.z = std::min(this->lower.z, vector[i].z);
+        upper.x = std::max(upper.x, vector[i].x);
+        upper.y = std::max(upper.y, vector[i].y);
+        upper.z = std::max(upper.z, vector[i].z);
+    }
+
+    this->step = Vert(0, 0, 0);
+    std::vector<float>().swap(this->floats);
+    std::vector<std::uint16_t>().swap(this->quants);
+
+    // Steps need a finite box, and floats cannot hold finite doubles past
+    // their range, so such vertices leave the pack empty.
+    auto LARGEST = double(std::numeric_limits<float>::max());
+    auto fits = true;
+
+    for (std::size_t i = 0; i != this->count && fits; i++)
+        for (auto value : {vector[i].x, vector[i].y, vector[i].z})
+            fits = fits && (quantize ? std::isfinite(value)
+                                     : !(std::abs(value) > LARGEST) ||
+                                           std::isinf(value));
+
+    if (quantize && this->count != 0 && fits)
+    {
+        this->step = Vert((upper.x - this->lower.x) / 65535,
+                          (upper.y - this->lower.y) / 65535,
+                          (upper.z - this->lower.z) / 65535);
+        fits = std::isfinite(this->step.x) && std::isfinite(this->step.y) &&
+               std::isfinite(this->step.z);
+    }
+
+    if (!fits)
+    {
+        this->count = 0;
+        this->dense = true;
+        this->step = Vert(0, 0, 0);
+        std::vector<std::size_t>().swap(this->idx);
+        return false;
+    }
+
+    if (quantize && this->count != 0)
+        this->quants.resize(3 * this->count);
+    else
+        this->floats.resize(3 * this->count);
+
+    auto round = [](double value, double lower, double step) {
+        return std::uint16_t(step > 0 ? std::lround((value - lower) / step)
+                                      : 0);
+    };
+
+    parallel_for(this->count, 4096, [&](std::size_t begin, std::size_t end) {
+        for (auto i = begin; i != end; i++)
+            if (!this->quants.empty())
+            {
+                this->quants[3 * i] = round(vector[i].x, this->lower.x,
+                                            this->step.x);
+                this->quants[3 * i + 1] = round(vector[i].y, this->lower.y,
+                                                this->step.y);
+                this->quants[3 * i + 2] = round(vector[i].z, this->lower.z,
+                                                this->step.z);
+            }
+            else
+            {
+                this->floats[3 * i] = float(vector[i].x);
+                this->floats[3 * i + 1] = float(vector[i].y);
+                this->floats[3 * i + 2] = float(vector[i].z);
+            }
+    });
+
+    return true;
+}
+
+void PackedVerts::unpack(Verts &verts) const
+{
+    std::vector<std::size_t> vectorIdx(this->count);
+    std::vector<Vert> vector(this->count);
+
+    if (this->count != 0)
+        this->copy_all(&vectorIdx[0], &vector[0]);
+
+    // Verts numbers inserts one past its largest index, so the vertices
+    // go in densely and are renumbered to their indices in one pass,
+    // which keeps the gaps without visiting them.
+    auto deferred = verts.defer();
+    verts.clear();
+    verts.defer(true);
+
+    for (std::size_t i = 0; i != this->count; i++)
+        verts.insert(vector[i]);
+
+    if (!this->dense)
+        verts.renumber(vectorIdx);
+
+    verts.defer(deferred);
+}
+
+Vert PackedVerts::operator[](std::size_t idx) const
+{
+    if (this->dense && idx < this->count)
+        return this->decode(idx);
+
+    auto found = std::lower_bound(this->idx.begin(), this->idx.end(), idx);
+
+    if (this->dense || found == this->idx.end() || *found != idx)
+    {
+        auto INF = std::numeric_limits<double>::infinity();
+        return Vert(INF, INF, INF);
+    }
+    else
+        return this->decode(found - this->idx.begin());
+}
+
+void PackedVerts::copy_all(Vert *ptr) const
+{
+    parallel_for(this->count, 4096, [&](std::size_t begin, std::size_t end) {
+        for (auto i = begin; i != end; i++)
+            ptr[i] = this->decode(i);
+    });
+}
+
+void PackedVerts::copy_all(std::size_t *ptrIdx, Vert *ptrVert) const
+{
+    this->copy_all(ptrVert);
+
+    for (std::size_t i = 0; i != this->count; i++)
+        ptrIdx[i] = this->dense ? i : this->idx[i];
+}
+
+std::size_t PackedVerts::size() const
+{
+    return this->count;
+}
+
+// The largest distance on each axis between a stored coordinate and the
+// one it came from.
+Vert PackedVerts::error() const
+{
+    if (!this->quants.empty())
+        return Vert(this->step.x / 2, this->step.y / 2, this->step.z / 2);
+
+    double largest = 0;
+
+    for (std::size_t i = 0; i != this->floats.size(); i++)
+        largest = std::max(largest, double(std::abs(this->floats[i])));
+
+    auto error = largest * std::numeric_limits<float>::epsilon() / 2;
+    return Vert(error, error, error);
+}
+
+std::map<std::string, std::size_t> PackedVerts::memory() const
+{
+    std::map<std::string, std::size_t> map;
+    map["idx"] = this->idx.capacity() * sizeof(std::size_t);
+    map["coords"] = this->floats.capacity() * sizeof(float) +
+                    this->quants.capacity() * sizeof(std::uint16_t);
+    return map;
+}
+
+std::size_t PackedEdges::decode(std::size_t block, Edge *ptrEdge) const
+{
+    auto first = block * BLOCK;
+    auto last = std::min(first + BLOCK, this->count);
+    auto ptr = this->bytes.data() + this->offsets[block];
+    ptrEdge[0] = this->heads[block];
+
+    for (std::size_t i = 1; i < last - first; i++)
+        ptrEdge[i] = get(ptr, ptrEdge[i - 1]);
+
+    return last - first;
+}
+
+void PackedEdges::pack(const Edges &edges)
+{
+    std::vector<Edge> vector(edges.size());
+
+    if (!vector.empty())
+        edges.copy_all(&vector[0]);
+
+    this->count = vector.size();
+    encode(vector, this->heads, this->offsets, this->bytes);
+
+    std::size_t countVerts = 0;
+
+    for (std::size_t i = 0; i != vector.size(); i++)
+        countVerts = std::max(countVerts, vector[i].v2 + 1);
+
+    std::vector<std::vector<std::size_t>> lists(countVerts);
+
+    for (std::size_t i = 0; i != vector.size(); i++)
+        lists[vector[i].v2].push_back(i);
+
+    index(lists, this->incidenceOffsets, this->incidence);
+}
+
+void PackedEdges::unpack(Edges &edges) const
+{
+    auto vector = decode_all(this->heads, this->offsets, this->bytes,
+                             this->count);
+    edges.clear();
+
+    for (std::size_t i = 0; i != vector.size(); i++)
+        edges.insert(vector[i]);
+}
+
+bool PackedEdges::find(Edge edge) const
+{
+    if (edge.v1 > edge.v2)
+        std::swap(edge.v1, edge.v2);
+
+    auto block = locate(this->heads, edge);
+
+    if (block == this->heads.size())
+        return false;
+
+    Edge edges[BLOCK];
+    auto size = this->decode(block, edges);
+    return std::binary_search(edges, edges + size, edge);
+}
+
+std::size_t PackedEdges::size() const
+{
+    return this->count;
+}
+
+std::set<Edge> PackedEdges::search(std::size_t idx) const
+{
+    std::set<Edge> set;
+    Edge edges[BLOCK];
+    auto block = locate(this->heads, Edge(idx, 0));
+
+    if (block == this->heads.size())
+        block = 0;
+
+    for (; block < this->heads.size() && this->heads[block].v1 <= idx;
+         block++)
+    {
+        auto size = this->decode(block, edges);
+
+        for (std::size_t i = 0; i != size; i++)
+            if (edges[i].v1 == idx)
+                set.insert(edges[i]);
+    }
+
+    auto list = lookup(this->incidenceOffsets, this->incidence, idx);
+    auto decoded = this->heads.size();
+
+    for (std::size_t i = 0; i != list.size(); i++)
+    {
+        if (list[i] / BLOCK != decoded)
+            decoded = list[i] / BLOCK, this->decode(decoded, edges);
+
+        set.insert(edges[list[i] % BLOCK]);
+    }
+
+    return set;
+}
+
+std::map<std::string, std::size_t> PackedEdges::memory() const
+{
+    std::map<std::string, std::size_t> map;
+    map["heads"] = this->heads.capacity() * sizeof(Edge) +
+                   this->offsets.capacity() * sizeof(std::size_t);
+    map["edges"] = this->bytes.capacity();
+    map["incidence"] = this->incidence.capacity() +
+                       this->incidenceOffsets.capacity() * sizeof(std::size_t);
+    return map;
+}
+
+
+std::size_t PackedFaces::decode(std::size_t block, Face *ptrFace) const
+{
+    auto first = block * BLOCK;
+    auto last = std::min(first + BLOCK, this->count);
+    auto ptr = this->bytes.data() + this->offsets[block];
+    ptrFace[0] = this->heads[block];
+
+    for (std::size_t i = 1; i < last - first; i++)
+        ptrFace[i] = get(ptr, ptrFace[i - 1]);
+
+    return last - first;
+}
+
+void PackedFaces::pack(const Faces &faces)
+{
+    std::vector<Face> vector(faces.size());
+    std::vector<void *> vectorPtr(faces.size());
+
+    if (!vector.empty())
+        faces.copy_all(&vector[0], &vectorPtr[0]);
+
+    this->count = vector.size();
+    encode(vector, this->heads, this->offsets, this->bytes);
+
+    // Payloads are kept in face order, and not at all when every one of
+    // them is null.
+    if (std::count(vectorPtr.begin(), vectorPtr.end(), nullptr) ==
+        std::ptrdiff_t(vectorPtr.size()))
+        std::vector<void *>().swap(this->ptrs);
+    else
+        this->ptrs.swap(vectorPtr);
+
+    std::size_t countVerts = 0;
+
+    for (std::size_t i = 0; i != vector.size(); i++)
+        countVerts = std::max(countVerts,
+                              std::max(vector[i].v2, vector[i].v3) + 1);
+
+    std::vector<std::vector<std::size_t>> lists(countVerts);
+
+    for (std::size_t i = 0; i != vector.size(); i++)
+    {
+        lists[vector[i].v2].push_back(i);
+        lists[vector[i].v3].push_back(i);
+    }
+
+    index(lists, this->incidenceOffsets, this->incidence);
+}
+
+void PackedFaces::unpack(Faces &faces) const
+{
+    auto vector = decode_all(this->heads, this->offsets, this->bytes,
+                             this->count);
+    auto deferred = faces.defer();
+    faces.clear();
+    faces.defer(true);
+
+    for (std::size_t i = 0; i != vector.size(); i++)
+        faces.insert(vector[i], this->ptrs.empty() ? nullptr : this->ptrs[i]);
+
+    faces.defer(deferred);
+}
+
+bool PackedFaces::find(Face face) const
+{
+    if (face.v2 < face.v3 && face.v2 < face.v1)
+        face = Face(face.v2, face.v3, face.v1);
+    else if (face.v3 < face.v1 && face.v3 < face.v2)
+        face = Face(face.v3, face.v1, face.v2);
+
+    auto block = locate(this->heads, face);
+
+    if (block == this->heads.size())
+        return false;
+
+    Face faces[BLOCK];
+    auto size = this->decode(block, faces);
+    return std::binary_search(faces, faces + size, face);
+}
+
+std::size_t PackedFaces::size() const
+{
+    return this->count;
+}
+
+std::set<Face> PackedFaces::search(std::size_t idx) const
+{
+    std::set<Face> set;
+    Face faces[BLOCK];
+    auto block = locate(this->heads, Face(idx, 0, 0));
+
+    if (block == this->heads.size())
+        block = 0;
+
+    for (; block < this->heads.size() && this->heads[block].v1 <= idx;
+         block++)
+    {
+        auto size = this->decode(block, faces);
+
+        for (std::size_t i = 0; i != size; i++)
+            if (faces[i].v1 == idx)
+                set.insert(faces[i]);
+    }
+
+    auto list = lookup(this->incidenceOffsets, this->incidence, idx);
+    auto decoded = this->heads.size();
+
+    for (std::size_t i = 0; i != list.size(); i++)
+    {
+        if (list[i] / BLOCK != decoded)
+            decoded = list[i] / BLOCK, this->decode(decoded, faces);
+
+        set.insert(faces[list[i] % BLOCK]);
+    }
+
+    return set;
+}
+
+std::map<std::string, std::size_t> PackedFaces::memory() const
+{
+    std::map<std::string, std::size_t> map;
+    map["heads"] = this->heads.capacity() * sizeof(Face) +
+                   this->offsets.capacity() * sizeof(std::size_t);
+    map["faces"] = this->bytes.capacity();
+    map["ptrs"] = this->ptrs.capacity() * sizeof(void *);
+    map["incidence"] = this->incidence.capacity() +
+                       this->incidenceOffsets.capacity() * sizeof(std::size_t);
+    return map;
+}
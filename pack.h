@@ -0,0 +1,88 @@
+#ifndef PACK_H
+#define PACK_H
+
+#ifdef __WIN32__
+#ifdef BUILD_LIB
+#define LIB_CLASS __declspec(dllexport)
+#else
+#define LIB_CLASS __declspec(dllimport)
+#endif
+#else
+#define LIB_CLASS
+#endif
+
+#include "mesh.h"
+#include <cstdint>
+
+
+class LIB_CLASS PackedVerts
+{
+    std::vector<std::size_t> idx;
+    std::vector<float> floats;
+    std::vector<std::uint16_t> quants;
+    Vert lower;
+    Vert step;
+    std::size_t count = 0;
+    bool dense = true;
+
+    Vert decode(std::size_t) const;
+
+public:
+    bool pack(const Verts &, bool);
+    void unpack(Verts &) const;
+
+    Vert operator[](std::size_t) const;
+    void copy_all(Vert *) const;
+    void copy_all(std::size_t *, Vert *) const;
+    std::size_t size() const;
+    Vert error() const;
+    std::map<std::string, std::size_t> memory() const;
+};
+
+
+class LIB_CLASS PackedEdges
+{
+    std::vector<Edge> heads;
+    std::vector<std::size_t> offsets;
+    std::vector<unsigned char> bytes;
+    std::vector<std::size_t> incidenceOffsets;
+    std::vector<unsigned char> incidence;
+    std::size_t count = 0;
+
+    std::size_t decode(std::size_t, Edge *) const;
+
+public:
+    void pack(const Edges &);
+    void unpack(Edges &) const;
+
+    bool find(Edge) const;
+    std::size_t size() const;
+    std::set<Edge> search(std::size_t) const;
+    std::map<std::string, std::size_t> memory() const;
+};
+
+
+class LIB_CLASS PackedFaces
+{
+    std::vector<Face> heads;
+    std::vector<std::size_t> offsets;
+    std::vector<unsigned char> bytes;
+    std::vector<std::size_t> incidenceOffsets;
+    std::vector<unsigned char> incidence;
+    std::vector<void *> ptrs;
+    std::size_t count = 0;
+
+    std::size_t decode(std::size_t, Face *) const;
+
+public:
+    void pack(const Faces &);
+    void unpack(Faces &) const;
+
+    bool find(Face) const;
+    std::size_t size() const;
+    std::set<Face> search(std::size_t) const;
+    std::map<std::string, std::size_t> memory() const;
+};
+
+
+#endif
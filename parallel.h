@@ -0,0 +1,43 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <thread>
+#include <vector>
+
+
+template <typename Function>
+void parallel_for(std::size_t size, std::size_t grain, Function function)
+{
+    std::size_t count = std::thread::hardware_concurrency();
+
+    if (count == 0)
+        count = 1;
+
+    if (grain == 0)
+        grain = 1;
+
+    if (count > (size + grain - 1) / grain)
+        count = (size + grain - 1) / grain;
+
+    if (count <= 1)
+    {
+        if (size != 0)
+            function(std::size_t(0), size);
+
+        return;
+    }
+
+    std::vector<std::thread> threads;
+
+    for (std::size_t i = 1; i != count; i++)
+        threads.push_back(std::thread(function, size * i / count,
+                                      size * (i + 1) / count));
+
+    function(std::size_t(0), size / count);
+
+    for (std::size_t i = 0; i != threads.size(); i++)
+        threads[i].join();
+}
+
+
+#endif
@@ -0,0 +1,426 @@
+#include "share.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#ifdef __WIN32__
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+// The segment starts with this header and continues with the arrays in
+// the order they are declared in Snapshot, every one of them sorted the
+// way the matching tree in Verts, Edges or Faces is. The magic is stored
+// last, so a segment that is still being written is not attached to.
+struct Header
+{
+    std::atomic<std::uint64_t> magic;
+    std::size_t countVerts;
+    std::size_t countEdges;
+    std::size_t countFaces;
+};
+
+static const std::uint64_t MAGIC = 0x4D455348534E5031ull;
+
+static std::size_t segment_size(std::size_t countVerts,
+                                std::size_t countEdges,
+                                std::size_t countFaces)
+{
+    return sizeof(Header) +
+           countVerts * (2 * sizeof(std::size_t) + sizeof(Vert)) +
+           countEdges * (sizeof(Edge) + sizeof(std::size_t)) +
+           countFaces * (sizeof(Face) + 2 * sizeof(std::size_t));
+}
+
+
+Snapshot::Snapshot()
+    : handle(nullptr), base(nullptr), length(0),
+      countVerts(0), countEdges(0), countFaces(0) {}
+
+Snapshot::~Snapshot()
+{
+    this->detach();
+}
+
+bool Snapshot::map(const std::string &name, std::size_t length, bool create)
+{
+#ifdef __WIN32__
+    HANDLE handle;
+
+    if (create)
+        handle = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                    DWORD(std::uint64_t(length) >> 32),
+                                    DWORD(length), name.c_str());
+    else
+        handle = OpenFileMappingA(FILE_MAP_READ, FALSE, name.c_str());
+
+    if (handle == NULL)
+        return false;
+
+    // A mapping that still exists has readers, and is not written over.
+    if (create && GetLastError() == ERROR_ALREADY_EXISTS)
+    {
+        CloseHandle(handle);
+        return false;
+    }
+
+    auto base = MapViewOfFile(handle, create ? FILE_MAP_ALL_ACCESS
+                                             : FILE_MAP_READ,
+                              0, 0, create ? length : 0);
+
+    if (base == NULL)
+    {
+        CloseHandle(handle);
+        return false;
+    }
+
+    if (!create)
+    {
+        MEMORY_BASIC_INFORMATION info;
+        VirtualQuery(base, &info, sizeof(info));
+        length = info.RegionSize;
+    }
+
+    this->handle = handle;
+#else
+    // The old segment is unlinked instead of truncated, so readers that
+    // still map it keep it whole while a new one is made under the name.
+    if (create)
+        shm_unlink(name.c_str());
+
+    auto fd = create ? shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644)
+                     : shm_open(name.c_str(), O_RDONLY, 0);
+
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+
+    if (create ? ftruncate(fd, length) != 0 : fstat(fd, &info) != 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    if (!create)
+        length = info.st_size;
+
+    auto base = mmap(nullptr, length,
+                     create ? PROT_READ | PROT_WRITE : PROT_READ,
+                     MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (base == MAP_FAILED)
+        return false;
+#endif
+
+    this->base = base;
+    this->length = length;
+    return true;
+}
+
+void Snapshot::bind()
+{
+    auto header = static_cast<const Header *>(this->base);
+    auto ptr = reinterpret_cast<const char *>(header + 1);
+
+    this->countVerts = header->countVerts;
+    this->countEdges = header->countEdges;
+    this->countFaces = header->countFaces;
+
+    this->idx = reinterpret_cast<const std::size_t *>(ptr);
+    ptr += this->countVerts * sizeof(std::size_t);
+    this->verts = reinterpret_cast<const Vert *>(ptr);
+    ptr += this->countVerts * sizeof(Vert);
+    this->vertsInv = reinterpret_cast<const std::size_t *>(ptr);
+    ptr += this->countVerts * sizeof(std::size_t);
+    this->edgesByV1 = reinterpret_cast<const Edge *>(ptr);
+    ptr += this->countEdges * sizeof(Edge);
+    this->edgesByV2 = reinterpret_cast<const std::size_t *>(ptr);
+    ptr += this->countEdges * sizeof(std::size_t);
+    this->facesByV1 = reinterpret_cast<const Face *>(ptr);
+    ptr += this->countFaces * sizeof(Face);
+    this->facesByV2 = reinterpret_cast<const std::size_t *>(ptr);
+    ptr += this->countFaces * sizeof(std::size_t);
+    this->facesByV3 = reinterpret_cast<const std::size_t *>(ptr);
+}
+
+bool Snapshot::publish(const std::string &name, const Verts &verts,
+                       const Edges &edges, const Faces &faces)
+{
+    this->detach();
+
+    auto countVerts = verts.size();
+    auto countEdges = edges.size();
+    auto countFaces = faces.size();
+
+    std::vector<std::size_t> vectorIdx(countVerts);
+    std::vector<Vert> vectorVerts(countVerts);
+    std::vector<std::size_t> vectorInv(countVerts);
+    std::vector<Edge> vectorEdges(countEdges);
+    std::vector<std::size_t> vectorEdgesByV2(countEdges);
+    std::vector<Face> vectorFaces(countFaces);
+    std::vector<void *> vectorPtr(countFaces);
+    std::vector<std::size_t> vectorFacesByV2(countFaces);
+    std::vector<std::size_t> vectorFacesByV3(countFaces);
+
+    if (countVerts != 0)
+        verts.copy_all(&vectorIdx[0], &vectorVerts[0]);
+
+    if (countEdges != 0)
+        edges.copy_all(&vectorEdges[0]);
+
+    if (countFaces != 0)
+        faces.copy_all(&vectorFaces[0], &vectorPtr[0]);
+
+    for (std::size_t i = 0; i != countVerts; i++)
+        vectorInv[i] = i;
+
+    for (std::size_t i = 0; i != countEdges; i++)
+        vectorEdgesByV2[i] = i;
+
+    for (std::size_t i = 0; i != countFaces; i++)
+        vectorFacesByV2[i] = vectorFacesByV3[i] = i;
+
+    std::sort(vectorInv.begin(), vectorInv.end(),
+              [&](std::size_t i, std::size_t j) {
+                  return vectorVerts[i] < vectorVerts[j];
+              });
+    std::stable_sort(vectorEdgesByV2.begin(), vectorEdgesByV2.end(),
+                     [&](std::size_t i, std::size_t j) {
+                         return vectorEdges[i].v2 < vectorEdges[j].v2;
+                     });
+    std::stable_sort(vectorFacesByV2.begin(), vectorFacesByV2.end(),
+                     [&](std::size_t i, std::size_t j) {
+                         return vectorFaces[i].v2 < vectorFaces[j].v2;
+                     });
+    std::stable_sort(vectorFacesByV3.begin(), vectorFacesByV3.end(),
+                     [&](std::size_t i, std::size_t j) {
+                         return vectorFaces[i].v3 < vectorFaces[j].v3;
+                     });
+
+    auto length = segment_size(countVerts, countEdges, countFaces);
+
+    if (!this->map(name, length, true))
+        return false;
+
+    auto header = static_cast<Header *>(this->base);
+    auto ptr = reinterpret_cast<char *>(header + 1);
+    auto copy = [&ptr](const void *data, std::size_t size) {
+        if (size != 0)
+            std::memcpy(ptr, data, size);
+
+        ptr += size;
+    };
+
+    copy(vectorIdx.data(), vectorIdx.size() * sizeof(std::size_t));
+    copy(vectorVerts.data(), vectorVerts.size() * sizeof(Vert));
+    copy(vectorInv.data(), vectorInv.size() * sizeof(std::size_t));
+    copy(vectorEdges.data(), vectorEdges.size() * sizeof(Edge));
+    copy(vectorEdgesByV2.data(),
+         vectorEdgesByV2.size() * sizeof(std::size_t));
+    copy(vectorFaces.data(), vectorFaces.size() * sizeof(Face));
+    copy(vectorFacesByV2.data(),
+         vectorFacesByV2.size() * sizeof(std::size_t));
+    copy(vectorFacesByV3.data(),
+         vectorFacesByV3.size() * sizeof(std::size_t));
+
+    header->countVerts = countVerts;
+    header->countEdges = countEdges;
+    header->countFaces = countFaces;
+    header->magic.store(MAGIC, std::memory_order_release);
+
+    this->bind();
+    return true;
+}
+
+bool Snapshot::attach(const std::string &name)
+{
+    this->detach();
+
+    if (!this->map(name, 0, false))
+        return false;
+
+    auto header = static_cast<const Header *>(this->base);
+
+    if (this->length < sizeof(Header) ||
+        header->magic.load(std::memory_order_acquire) != MAGIC ||
+        this->length < segment_size(header->countVerts, header->countEdges,
+                                    header->countFaces))
+    {
+        this->detach();
+        return false;
+    }
+
+    this->bind();
+    return true;
+}
+
+void Snapshot::detach()
+{
+    if (this->base == nullptr)
+        return;
+
+#ifdef __WIN32__
+    UnmapViewOfFile(this->base);
+    CloseHandle(this->handle);
+#else
+    munmap(this->base, this->length);
+#endif
+
+    this->handle = nullptr;
+    this->base = nullptr;
+    this->length = 0;
+    this->countVerts = 0;
+    this->countEdges = 0;
+    this->countFaces = 0;
+}
+
+void Snapshot::unlink(const std::string &name)
+{
+#ifndef __WIN32__
+    shm_unlink(name.c_str());
+#else
+    (void)name;
+#endif
+}
+
+Vert Snapshot::operator[](std::size_t idx) const
+{
+    auto lower = this->idx, upper = this->idx + this->countVerts;
+    auto found = std::lower_bound(lower, upper, idx);
+
+    if (found == upper || *found != idx)
+    {
+        auto INF = std::numeric_limits<double>::infinity();
+        return Vert(INF, INF, INF);
+    }
+    else
+        return this->verts[found - lower];
+}
+
+bool Snapshot::find(Edge edge) const
+{
+    if (edge.v1 > edge.v2)
+        std::swap(edge.v1, edge.v2);
+
+    return std::binary_search(this->edgesByV1,
+                              this->edgesByV1 + this->countEdges, edge);
+}
+
+bool Snapshot::find(Face face) const
+{
+    if (face.v2 < face.v3 && face.v2 < face.v1)
+        face = Face(face.v2, face.v3, face.v1);
+    else if (face.v3 < face.v1 && face.v3 < face.v2)
+        face = Face(face.v3, face.v1, face.v2);
+
+    return std::binary_search(this->facesByV1,
+                              this->facesByV1 + this->countFaces, face);
+}
+
+std::size_t Snapshot::size_verts() const
+{
+    return this->countVerts;
+}
+
+std::size_t Snapshot::size_edges() const
+{
+    return this->countEdges;
+}
+
+std::size_t Snapshot::size_faces() const
+{
+    return this->countFaces;
+}
+
+std::set<std::size_t> Snapshot::search(const Vert &vert) const
+{
+    std::set<std::size_t> set;
+    auto verts = this->verts;
+    auto lower = std::lower_bound(
+        this->vertsInv, this->vertsInv + this->countVerts, vert,
+        [verts](std::size_t i, const Vert &vert) { return verts[i] < vert; });
+    auto upper = std::upper_bound(
+        this->vertsInv, this->vertsInv + this->countVerts, vert,
+        [verts](const Vert &vert, std::size_t i) { return vert < verts[i]; });
+
+    for (auto iter = lower; iter != upper; iter++)
+        set.insert(this->idx[*iter]);
+
+    return set;
+}
+
+std::set<Edge> Snapshot::search_edges(std::size_t idx) const
+{
+    std::set<Edge> set;
+    auto lower = std::lower_bound(this->edgesByV1,
+                                  this->edgesByV1 + this->countEdges,
+                                  Edge(idx, 0));
+    auto upper = std::upper_bound(this->edgesByV1,
+                                  this->edgesByV1 + this->countEdges,
+                                  Edge(idx, -1));
+
+    for (auto iter = lower; iter != upper; iter++)
+        set.insert(*iter);
+
+    auto edges = this->edgesByV1;
+    auto lower2 = std::lower_bound(
+        this->edgesByV2, this->edgesByV2 + this->countEdges, idx,
+        [edges](std::size_t i, std::size_t idx) { return edges[i].v2 < idx; });
+    auto upper2 = std::upper_bound(
+        this->edgesByV2, this->edgesByV2 + this->countEdges, idx,
+        [edges](std::size_t idx, std::size_t i) { return idx < edges[i].v2; });
+
+    for (auto iter = lower2; iter != upper2; iter++)
+        set.insert(edges[*iter]);
+
+    return set;
+}
+
+std::set<Face> Snapshot::search_faces(std::size_t idx) const
+{
+    std::set<Face> set;
+    auto lower = std::lower_bound(this->facesByV1,
+                                  this->facesByV1 + this->countFaces,
+                                  Face(idx, 0, 0));
+    auto upper = std::upper_bound(this->facesByV1,
+                                  this->facesByV1 + this->countFaces,
+                                  Face(idx, -1, -1));
+
+    for (auto iter = lower; iter != upper; iter++)
+        set.insert(*iter);
+
+    auto faces = this->facesByV1;
+    auto lower2 = std::lower_bound(
+        this->facesByV2, this->facesByV2 + this->countFaces, idx,
+        [faces](std::size_t i, std::size_t idx) { return faces[i].v2 < idx; });
+    auto upper2 = std::upper_bound(
+        this->facesByV2, this->facesByV2 + this->countFaces, idx,
+        [faces](std::size_t idx, std::size_t i) { return idx < faces[i].v2; });
+
+    for (auto iter = lower2; iter != upper2; iter++)
+        set.insert(faces[*iter]);
+
+    auto lower3 = std::lower_bound(
+        this->facesByV3, this->facesByV3 + this->countFaces, idx,
+        [faces](std::size_t i, std::size_t idx) { return faces[i].v3 < idx; });
+    auto upper3 = std::upper_bound(
+        this->facesByV3, this->facesByV3 + this->countFaces, idx,
+        [faces](std::size_t idx, std::size_t i) { return idx < faces[i].v3; });
+
+    for (auto iter = lower3; iter != upper3; iter++)
+        set.insert(faces[*iter]);
+
+    return set;
+}
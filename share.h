@@ -0,0 +1,63 @@
+#ifndef SHARE_H
+#define SHARE_H
+
+#ifdef __WIN32__
+#ifdef BUILD_LIB
+#define LIB_CLASS __declspec(dllexport)
+#else
+#define LIB_CLASS __declspec(dllimport)
+#endif
+#else
+#define LIB_CLASS
+#endif
+
+#include "mesh.h"
+
+
+class LIB_CLASS Snapshot
+{
+    void *handle;
+    void *base;
+    std::size_t length;
+
+    const std::size_t *idx;
+    const Vert *verts;
+    const std::size_t *vertsInv;
+    const Edge *edgesByV1;
+    const std::size_t *edgesByV2;
+    const Face *facesByV1;
+    const std::size_t *facesByV2;
+    const std::size_t *facesByV3;
+    std::size_t countVerts;
+    std::size_t countEdges;
+    std::size_t countFaces;
+
+    bool map(const std::string &, std::size_t, bool);
+    void bind();
+
+public:
+    Snapshot();
+    Snapshot(const Snapshot &) = delete;
+    Snapshot &operator=(const Snapshot &) = delete;
+    ~Snapshot();
+
+    bool publish(const std::string &,
+                 const Verts &, const Edges &, const Faces &);
+    bool attach(const std::string &);
+    void detach();
+    static void unlink(const std::string &);
+
+    Vert operator[](std::size_t) const;
+    bool find(Edge) const;
+    bool find(Face) const;
+
+    std::size_t size_verts() const;
+    std::size_t size_edges() const;
+    std::size_t size_faces() const;
+    std::set<std::size_t> search(const Vert &) const;
+    std::set<Edge> search_edges(std::size_t) const;
+    std::set<Face> search_faces(std::size_t) const;
+};
+
+
+#endif
@@ -0,0 +1,374 @@
+#include "topo.h"
+#include "parallel.h"
+#include <algorithm>
+#include <atomic>
+
+
+// Buckets half edges (or corners) by vertex with a counting sort, which
+// gives per vertex ranges without a global comparison sort.
+static void bucket(const std::vector<std::size_t> &keys, std::size_t count,
+                   std::vector<std::size_t> &offsets,
+                   std::vector<std::size_t> &order)
+{
+    offsets.assign(count + 1, 0);
+    order.resize(keys.size());
+
+    for (std::size_t i = 0; i != keys.size(); i++)
+        offsets[keys[i] + 1]++;
+
+    for (std::size_t i = 0; i != count; i++)
+        offsets[i + 1] += offsets[i];
+
+    std::vector<std::size_t> fill(offsets.begin(), offsets.end() - 1);
+
+    for (std::size_t i = 0; i != keys.size(); i++)
+        order[fill[keys[i]]++] = i;
+}
+
+
+// Lock-free union-find with path halving. Roots are always linked under
+// the smaller index, so the final root of a set is its smallest vertex
+// whatever order the threads run in.
+static std::size_t find(std::vector<std::atomic<std::size_t>> &parents,
+                        std::size_t idx)
+{
+    while (true)
+    {
+        auto parent = parents[idx].load();
+
+        if (parent == idx)
+            return idx;
+
+        auto grand = parents[parent].load();
+
+        if (grand != parent)
+            parents[idx].compare_exchange_weak(parent, grand);
+
+        idx = grand;
+    }
+}
+
+static void unite(std::vector<std::atomic<std::size_t>> &parents,
+                  std::size_t idx1, std::size_t idx2)
+{
+    while (true)
+    {
+        idx1 = find(parents, idx1);
+        idx2 = find(parents, idx2);
+
+        if (idx1 == idx2)
+            return;
+
+        if (idx1 < idx2)
+            std::swap(idx1, idx2);
+
+        auto expected = idx1;
+
+        if (parents[idx1].compare_exchange_strong(expected, idx2))
+            return;
+    }
+}
+
+
+void Topo::analyze(const Faces &faces,
+                   std::vector<Edge> &boundary,
+                   std::vector<Edge> &nonManifold,
+                   std::vector<Edge> &flipped,
+                   std::vector<std::size_t> &boundaryVerts,
+                   std::vector<std::size_t> &nonManifoldVerts,
+                   std::vector<std::vector<std::size_t>> &loops)
+{
+    boundary.clear();
+    nonManifold.clear();
+    flipped.clear();
+    boundaryVerts.clear();
+    nonManifoldVerts.clear();
+    loops.clear();
+
+    std::vector<Face> vectorFaces(faces.size());
+    std::vector<void *> vectorPtr(faces.size());
+
+    if (vectorFaces.empty())
+        return;
+
+    faces.copy_all(&vectorFaces[0], &vectorPtr[0]);
+    std::size_t count = 0;
+
+    for (std::size_t i = 0; i != vectorFaces.size(); i++)
+        count = std::max(count, std::max(vectorFaces[i].v1,
+                                         std::max(vectorFaces[i].v2,
+                                                  vectorFaces[i].v3)) +
+                                    1);
+
+    // Half edge 3 * i + j runs from corner j to corner j + 1 of face i.
+    std::vector<Edge> halves(vectorFaces.size() * 3);
+    std::vector<std::size_t> keys(halves.size());
+
+    for (std::size_t i = 0; i != vectorFaces.size(); i++)
+    {
+        halves[3 * i] = Edge(vectorFaces[i].v1, vectorFaces[i].v2);
+        halves[3 * i + 1] = Edge(vectorFaces[i].v2, vectorFaces[i].v3);
+        halves[3 * i + 2] = Edge(vectorFaces[i].v3, vectorFaces[i].v1);
+    }
+
+    for (std::size_t i = 0; i != halves.size(); i++)
+        keys[i] = std::min(halves[i].v1, halves[i].v2);
+
+    std::vector<std::size_t> offsets, order;
+    bucket(keys, count, offsets, order);
+
+    // 0 interior, 1 boundary, 2 non-manifold, 3 two faces running the same
+    // way along it, stored on the first half edge of every group sharing
+    // the same two vertices.
+    std::vector<char> kinds(halves.size(), -1);
+
+    parallel_for(count, 1024, [&](std::size_t begin, std::size_t end) {
+        for (auto v = begin; v != end; v++)
+        {
+            auto first = order.begin() + offsets[v];
+            auto last = order.begin() + offsets[v + 1];
+
+            std::sort(first, last, [&](std::size_t a, std::size_t b) {
+                return std::max(halves[a].v1, halves[a].v2) <
+                       std::max(halves[b].v1, halves[b].v2);
+            });
+
+            for (auto iter = first; iter != last;)
+            {
+                auto other = std::max(halves[*iter].v1, halves[*iter].v2);
+                auto next = iter;
+
+                while (next != last &&
+                       std::max(halves[*next].v1, halves[*next].v2) == other)
+                    next++;
+
+                if (next - iter == 2)
+                    kinds[*iter] = halves[*iter].v1 == halves[*(iter + 1)].v1
+                                       ? 3
+                                       : 0;
+                else
+                    kinds[*iter] = next - iter == 1 ? 1 : 2;
+                iter = next;
+            }
+        }
+    });
+
+    std::vector<char> kindsVerts(count, 0), flippedVerts(count, 0);
+
+    for (std::size_t i = 0; i != halves.size(); i++)
+        if (kinds[i] == 1)
+        {
+            boundary.push_back(halves[i]);
+            kindsVerts[halves[i].v1] = std::max(kindsVerts[halves[i].v1], char(1));
+            kindsVerts[halves[i].v2] = std::max(kindsVerts[halves[i].v2], char(1));
+        }
+        else if (kinds[i] == 2)
+        {
+            auto edge = halves[i];
+
+            if (edge.v1 > edge.v2)
+                std::swap(edge.v1, edge.v2);
+
+            nonManifold.push_back(edge);
+            kindsVerts[edge.v1] = 2;
+            kindsVerts[edge.v2] = 2;
+        }
+        else if (kinds[i] == 3)
+        {
+            auto edge = halves[i];
+
+            if (edge.v1 > edge.v2)
+                std::swap(edge.v1, edge.v2);
+
+            flipped.push_back(edge);
+            flippedVerts[edge.v1] = 1;
+            flippedVerts[edge.v2] = 1;
+        }
+
+    // A vertex whose incident faces form more than one fan is pinched
+    // even when all of its edges are manifold. The corners at a vertex are
+    // sorted by the edge they leave along, so the corner following each
+    // one is found with a binary search.
+    for (std::size_t i = 0; i != keys.size(); i++)
+        keys[i] = halves[i].v1;
+
+    bucket(keys, count, offsets, order);
+    std::vector<std::size_t> following(order.size());
+    std::vector<char> marks(order.size(), 0);
+
+    parallel_for(count, 1024, [&](std::size_t begin, std::size_t end) {
+        for (auto v = begin; v != end; v++)
+        {
+            if (kindsVerts[v] == 2 || flippedVerts[v] ||
+                offsets[v] == offsets[v + 1])
+                continue;
+
+            // The corner at v is (v, a, b): a ends the half edge leaving
+            // v and b starts the half edge of the same face entering v.
+            auto first = offsets[v], last = offsets[v + 1];
+            auto a = [&](std::size_t k) { return halves[order[k]].v2; };
+            auto b = [&](std::size_t k) {
+                auto half = order[k];
+                return halves[half % 3 == 0 ? half + 2 : half - 1].v1;
+            };
+
+            std::sort(order.begin() + first, order.begin() + last,
+                      [&](std::size_t x, std::size_t y) {
+                          return halves[x].v2 < halves[y].v2;
+                      });
+
+            bool broken = false;
+
+            for (auto k = first; k != last; k++)
+            {
+                auto j = std::size_t(
+                    std::lower_bound(order.begin() + first,
+                                     order.begin() + last, b(k),
+                                     [&](std::size_t half, std::size_t idx) {
+                                         return halves[half].v2 < idx;
+                                     }) -
+                    order.begin());
+                following[k] = j != last && a(j) == b(k) ? j : last;
+
+                if (following[k] != last && marks[j])
+                    broken = true;
+                else if (following[k] != last)
+                    marks[j] = 1;
+            }
+
+            // Open fans are walked from the corners nothing leads into,
+            // what is left are closed fans.
+            std::size_t fans = 0;
+
+            for (int pass = 0; pass != 2 && !broken; pass++)
+                for (auto k = first; k != last; k++)
+                {
+                    if (marks[k] & 2 || (pass == 0 && marks[k] & 1))
+                        continue;
+
+                    fans++;
+
+                    for (auto j = k; j != last && !(marks[j] & 2);
+                         j = following[j])
+                        marks[j] |= 2;
+                }
+
+            if (broken || fans > 1)
+                kindsVerts[v] = 2;
+        }
+    });
+
+    for (std::size_t v = 0; v != count; v++)
+        if (kindsVerts[v] == 1)
+            boundaryVerts.push_back(v);
+        else if (kindsVerts[v] == 2)
+            nonManifoldVerts.push_back(v);
+
+    // Boundary edges follow the face winding, so a loop is walked by
+    // leaving each vertex along one of its unused outgoing edges.
+    keys.resize(boundary.size());
+
+    for (std::size_t i = 0; i != boundary.size(); i++)
+        keys[i] = boundary[i].v1;
+
+    bucket(keys, count, offsets, order);
+    std::vector<std::size_t> cursor(offsets.begin(), offsets.end() - 1);
+
+    for (std::size_t i = 0; i != boundary.size(); i++)
+    {
+        auto v = boundary[i].v1;
+
+        if (cursor[v] == offsets[v + 1])
+            continue;
+
+        std::vector<std::size_t> loop;
+
+        while (cursor[v] != offsets[v + 1])
+        {
+            loop.push_back(v);
+            v = boundary[order[cursor[v]++]].v2;
+        }
+
+        loops.push_back(loop);
+    }
+}
+
+std::size_t Topo::components(const Faces &faces,
+                             std::vector<std::size_t> &labels,
+                             std::vector<std::size_t> &sizes)
+{
+    labels.clear();
+    sizes.clear();
+
+    std::vector<Face> vectorFaces(faces.size());
+    std::vector<void *> vectorPtr(faces.size());
+
+    if (vectorFaces.empty())
+        return 0;
+
+    faces.copy_all(&vectorFaces[0], &vectorPtr[0]);
+    std::size_t count = 0;
+
+    for (std::size_t i = 0; i != vectorFaces.size(); i++)
+        count = std::max(count, std::max(vectorFaces[i].v1,
+                                         std::max(vectorFaces[i].v2,
+                                                  vectorFaces[i].v3)) +
+                                    1);
+
+    std::vector<std::atomic<std::size_t>> parents(count);
+
+    parallel_for(count, 4096, [&](std::size_t begin, std::size_t end) {
+        for (auto i = begin; i != end; i++)
+            parents[i].store(i);
+    });
+
+    parallel_for(vectorFaces.size(), 4096,
+                 [&](std::size_t begin, std::size_t end) {
+                     for (auto i = begin; i != end; i++)
+                     {
+                         unite(parents, vectorFaces[i].v1, vectorFaces[i].v2);
+                         unite(parents, vectorFaces[i].v1, vectorFaces[i].v3);
+                     }
+                 });
+
+    // Components are numbered in the order of their first face.
+    std::vector<std::size_t> ids(count, -1);
+    labels.resize(vectorFaces.size());
+
+    for (std::size_t i = 0; i != vectorFaces.size(); i++)
+    {
+        auto root = find(parents, vectorFaces[i].v1);
+
+        if (ids[root] == std::size_t(-1))
+        {
+            ids[root] = sizes.size();
+            sizes.push_back(0);
+        }
+
+        labels[i] = ids[root];
+        sizes[labels[i]]++;
+    }
+
+    return sizes.size();
+}
+
+std::size_t Topo::components(const Faces &faces,
+                             std::vector<Faces> &parts)
+{
+    std::vector<std::size_t> labels, sizes;
+    auto count = Topo::components(faces, labels, sizes);
+
+    std::vector<Face> vectorFaces(faces.size());
+    std::vector<void *> vectorPtr(faces.size());
+
+    if (!vectorFaces.empty())
+        faces.copy_all(&vectorFaces[0], &vectorPtr[0]);
+
+    parts.clear();
+    parts.resize(count);
+
+    for (std::size_t i = 0; i != vectorFaces.size(); i++)
+        parts[labels[i]].insert(vectorFaces[i], vectorPtr[i]);
+
+    return count;
+}
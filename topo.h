@@ -0,0 +1,33 @@
+#ifndef TOPO_H
+#define TOPO_H
+
+#ifdef __WIN32__
+#ifdef BUILD_LIB
+#define LIB_CLASS __declspec(dllexport)
+#else
+#define LIB_CLASS __declspec(dllimport)
+#endif
+#else
+#define LIB_CLASS
+#endif
+
+#include "mesh.h"
+
+
+class LIB_CLASS Topo
+{
+public:
+    static void analyze(const Faces &,
+                        std::vector<Edge> &, std::vector<Edge> &,
+                        std::vector<Edge> &,
+                        std::vector<std::size_t> &,
+                        std::vector<std::size_t> &,
+                        std::vector<std::vector<std::size_t>> &);
+    static std::size_t components(const Faces &,
+                                  std::vector<std::size_t> &,
+                                  std::vector<std::size_t> &);
+    static std::size_t components(const Faces &, std::vector<Faces> &);
+};
+
+
+#endif